@@ -32,6 +32,8 @@ LOCAL_C_INCLUDES 	:=  $(REPOSITORIES_DIR)/curl/include $(XTRALIFE_DIR)/sources
 LOCAL_SRC_FILES		:= 	$(XTRALIFE_DIR)/sources/Core/CCallback.cpp				                            \
 						$(XTRALIFE_DIR)/sources/Core/CClannishRESTproxy.cpp		                            \
 						$(XTRALIFE_DIR)/sources/Core/CHjSON.cpp					                            \
+						$(XTRALIFE_DIR)/sources/Core/CJsonReader.cpp			                            \
+						$(XTRALIFE_DIR)/sources/Core/CJsonStruct.cpp			                            \
 						$(XTRALIFE_DIR)/sources/Core/ErrorStrings.cpp			                            \
 						$(XTRALIFE_DIR)/sources/Core/XtraLife_thread.cpp				                    \
 						$(XTRALIFE_DIR)/sources/Misc/XtraLifeHelpers.cpp				                    \
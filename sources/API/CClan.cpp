@@ -113,6 +113,7 @@ namespace XtraLife {
 		CUserManager::Instance()->Terminate();
 		CFilesystemManager::Instance()->Terminate();
 		CStoreManager::Instance()->Terminate();
+		CThreadPool::Terminate();
 		managerSingleton.Release();
 	}
 	
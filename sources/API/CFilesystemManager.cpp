@@ -43,15 +43,37 @@ void CFilesystemManager::SetFilesystemHandler(CFilesystemHandler *handler, bool
 XtraLife::Helpers::CHJSON * CFilesystemManager::ReadJson(const char *relativeName) {
 	owned_ref<CInputFile> file (OpenFileForReading(relativeName));
 	if (file->IsOpen()) {
-		cstring contents (file->ReadAll(), true);
-		return CHJSON::parse(contents);
+		// The binary form is decoded right from the file when it can be mapped
+		size_t size;
+		const void *data = file->Map(size);
+		CHJSON *json = data ? CHJSON::parseBinary(data, size) : NULL;
+		if (json) {
+			return json;
+		}
+
+		cstring contents (file->ReadAll(&size), true);
+		if (!contents) {
+			return NULL;
+		}
+		json = CHJSON::parseBinary(contents.c_str(), size);
+		return json ? json : CHJSON::parse(contents);
 	}
 	return NULL;
 }
 
-bool CFilesystemManager::WriteJson(const char *relativeName, const XtraLife::Helpers::CHJSON *json) {
+bool CFilesystemManager::WriteJson(const char *relativeName, const XtraLife::Helpers::CHJSON *json, bool binary) {
 	owned_ref<COutputFile> file (OpenFileForWriting(relativeName));
 	if (file->IsOpen()) {
+		if (binary) {
+			size_t size;
+			void *data = json->printBinary(size);
+			if (!data) {
+				return false;
+			}
+			size_t written = file->Write(data, size);
+			free(data);
+			return written == size;
+		}
 		cstring result = json->print();
 		file->Write(result, strlen(result));
 		return true;
@@ -64,7 +86,7 @@ void XtraLife::CFilesystemManager::SetFolderHint(const char *newAppFolder) {
 	CFilesystem_appFolder = strdup(newAppFolder);
 }
 
-char *CInputFile::ReadAll() {
+char *CInputFile::ReadAll(size_t *readSize) {
 	if (!IsOpen()) {
 		return NULL;
 	}
@@ -77,9 +99,15 @@ char *CInputFile::ReadAll() {
 	size = Tell() - start;
 	
 	// Read all
-	char *result = new char[size + 1];
+	char *result = (char*) malloc(size + 1);
+	if (!result) {
+		return NULL;
+	}
 	Seek(0, SEEK_SET);
-	Read(result, size);
+	size = Read(result, size);
 	result[size] = '\0';
+	if (readSize) {
+		*readSize = size;
+	}
 	return result;
 }
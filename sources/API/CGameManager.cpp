@@ -39,7 +39,7 @@ namespace XtraLife {
 		if (!CClan::Instance()->isUserLogged()) { InvokeHandler(aHandler, enNotLogged); }
 		
 		CHJSON json;
-		json.Put("score", (double)aHighScore);
+		json.Put("score", aHighScore);
 		json.Put("mode", aMode);
 		json.Put("order", aScoreType);
 		json.Put("domain", aDomain);
@@ -57,7 +57,7 @@ namespace XtraLife {
 		if (!CClan::Instance()->isUserLogged()) { InvokeHandler(handler, enNotLogged); }
 		
 		CHJSON json;
-		json.Put("score", (double)aScore);
+		json.Put("score", aScore);
 		json.Put("mode", aMode);
 		json.Put("domain", aDomain);
 		CClannishRESTProxy::Instance()->GetRank(&json, MakeBridgeDelegate(handler));
@@ -142,9 +142,7 @@ namespace XtraLife {
 
     void CGameManager::getBinaryDone(const CCloudResult *result, CResultHandler *aHandler) {
         if (result->GetErrorCode() != enNoErr) { InvokeHandler(aHandler, result); return; }
-        const CHJSON* jsonBlob = result->GetJSON()->Get("result");
-        const CHJSON* jsonUrl = jsonBlob->Get(0);
-        const char *url = jsonUrl->valueString();
+        const char *url = result->GetJSON()->AtSafe("/result/0")->valueString();
         if (url == NULL || *url ==0 ) return InvokeHandler(aHandler, enServerError);
         CClannishRESTProxy::Instance()->DownloadData(url, MakeBridgeDelegate(aHandler));
     }
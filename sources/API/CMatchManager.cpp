@@ -334,7 +334,7 @@ void CMatch::onEventReceived(const char *domain, const CCloudResult *event) {
 }
 
 void CMatch::onEventError(eErrorCode aErrorCode, const char *aDomain, const CCloudResult *result) {
-	// Don't care, will be handled well enough by the PopEventLoopThread
+	// Don't care, will be handled well enough by the event loop
 }
 
 //////////////////////////// Raw match API ////////////////////////////
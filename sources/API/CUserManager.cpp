@@ -9,6 +9,7 @@
 #include "include/CUserManager.h"
 #include "include/CFilesystemManager.h"
 #include "include/CHJSON.h"
+#include "include/CJsonStruct.h"
 #include "Core/CCallback.h"
 #include "Core/CStoreInterface.h"
 #include "Core/CClannishRESTProxy.h"
@@ -88,9 +89,11 @@ namespace XtraLife {
 
 	void CUserManager::didLogin(const CCloudResult *result) {
 		if (result->GetErrorCode() == enNoErr) {
-			persistedLoginParams.mGamerId = result->GetJSON()->GetString("gamer_id");
-			persistedLoginParams.mGamerSecret = result->GetJSON()->GetString("gamer_secret");
-			mAccountNetwork = result->GetJSON()->GetString("network");
+			CLoginResult login;
+			CJsonStruct::Decode(result->GetJSON(), login);
+			persistedLoginParams.mGamerId = std::move(login.gamer_id);
+			persistedLoginParams.mGamerSecret = std::move(login.gamer_secret);
+			mAccountNetwork = std::move(login.network);
 			CommitLoginParams();
 			// If we're effectively logged in, launch a listener for the private event domain
 			if (CClannishRESTProxy::Instance()->autoRegisterForNotification())
@@ -543,9 +546,7 @@ namespace XtraLife {
     
     void CUserManager::getBinaryDone(const CCloudResult *result, CResultHandler *aHandler) {
         if (result->GetErrorCode() != enNoErr) { InvokeHandler(aHandler, result); return; }
-        const CHJSON* jsonBlob = result->GetJSON()->Get("result");
-        const CHJSON* jsonUrl = jsonBlob->Get(0);
-        const char *url = jsonUrl->valueString();
+        const char *url = result->GetJSON()->AtSafe("/result/0")->valueString();
         if (url == NULL || *url ==0 ) return InvokeHandler(aHandler, enServerError);
         CClannishRESTProxy::Instance()->DownloadData(url, MakeBridgeDelegate(aHandler));
     }
@@ -215,7 +215,7 @@ namespace XtraLife
 	void CThreadCloud::run(const char *webmethod)
 	{
 		if (webmethod == NULL ) // || !CThreadCloud::BacthAdd(method, mJSON))
-			this->Start();
+			CThreadPool::Submit(this);
 	}
 
 	void CThreadCloud::Run() {
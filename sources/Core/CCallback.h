@@ -45,7 +45,10 @@ namespace XtraLife {
 
 	};
 
-	class CThreadCloud : public XtraLife::Helpers::CThread {
+	/**
+	 * Task running execute() on the thread pool, then done() with its result on the main thread. Deletes itself afterwards.
+	 */
+	class CThreadCloud : public XtraLife::Helpers::CThreadPool::CTask {
 	public:
 		CThreadCloud();
 		~CThreadCloud();
@@ -9,6 +9,10 @@
 #ifndef XtraLifelib_CConnectionREST_h
 #define XtraLifelib_CConnectionREST_h
 
+#include <atomic>
+#include <unordered_map>
+#include <vector>
+
 #include "include/CClan.h"
 #include "include/CHJSON.h"
 #include "include/CDelegate.h"
@@ -22,6 +26,7 @@ namespace XtraLife {
 
     struct CEventListener;
     struct CHttpRequest;
+    class CHttpHeaders;
 
     typedef enum  etTypeFS {
 		fsApp = 1,
@@ -164,7 +169,7 @@ namespace XtraLife {
 		 */
 		eErrorCode RegisterEventListener(const char *domain, CEventListener *listener);
 		/**
-		 * Unregisters an event listener, killing the associated thread when no more listeners are left for a given domain.
+		 * Unregisters an event listener, stopping the polling of a given domain when no more listeners are left for it.
 		 * @param domain the domain for which the listener was registered
 		 * @param listener the listener to remove (Release will be called on it, potentially deleting it)
 		 * @param acquireLock internal parameter, leave it to true when using from outside
@@ -183,30 +188,44 @@ namespace XtraLife {
 		const char *GetMail();
 		const char *GetAppID();
 		
-		bool isLinkedWith(const char *network) { return IsEqual(mNetwork, network) || mLinks->Has(network);  }
+		bool isLinkedWith(const char *network);
 
 		bool autoRegisterForNotification() { return mRegisterForNotification; }
 		
 	private:
-		// Background thread issuing "pop" commands to the server.
-		class PopEventLoopThread;
-		Helpers::CMutex popEventThreadMutex;
+		// Background thread issuing "pop" commands to the server, for every domain listened to.
+		class EventLoopThread;
+		class EventDomain;
+		class EventTransport;
+		// Hash of the name of a domain, for eventDomains
+		struct EventDomainHash {
+			size_t operator () (const Helpers::cstring &domain) const;
+		};
+		Helpers::CReadWriteLock eventDomainsLock;
 		Helpers::CConditionVariable suspendedThreadLock;
+		// Logged in gamer; see CurrentSession()
+		struct Session;
 
 		/** singleton */
 		Helpers::CHJSON *mQueuesURL;
 		Helpers::CHJSON *mJSONBatch;
 
 		Helpers::cstring mApiKey, mApiSecret;
-		Helpers::cstring mGamerId, mGamerSecret;
-		Helpers::cstring mNetwork, mNetworkId;
-		Helpers::cstring mDisplayName, mEmail;
 		Helpers::cstring mAppID, mAppVersion, mSdkVersion;
-		std::vector< Helpers::autoref<PopEventLoopThread> > popEventThreads;
+		// Headers of the requests made while logged out (the session has its own)
+		Helpers::autoref<CHttpHeaders> mAppHeaders;
+		std::atomic<Session*> mSession;
+		// Every session ever published, kept until the end so that readers of an older one are never left dangling
+		std::vector< Helpers::autoref<Session> > mSessions;
+		Helpers::CMutex mSessionsMutex;
+		std::unordered_map<Helpers::cstring, Helpers::autoref<EventDomain>, EventDomainHash> eventDomains;
+		// Incremented whenever a domain is added or removed, so that the event loop only copies eventDomains when it changed
+		std::atomic<unsigned> eventDomainsVersion;
+		Helpers::autoref<EventLoopThread> eventLoop;
 		int mPopEventLoopDelay;			// in sec
+		int mEventBatchSize;			// events the server may return per pop request
+		Helpers::cstring mEventTransport;
 
-		Helpers::CHJSON *mLinks;
-		
 		bool mNetSate, mSuspend;
 		bool mRegisterForNotification;
 		
@@ -222,8 +241,17 @@ namespace XtraLife {
 		void Terminate();
 
 		bool HandleEvent(const Helpers::CHJSON *ajSON);
-		// Please acquire popEventThreadMutex before calling this!
-		PopEventLoopThread *FindEventThread(const char *domain);
+		/**
+		 * @return the session of the logged in gamer, or an empty one if logged out. It never changes: safe to read from any
+		 * thread without locking.
+		 */
+		const Session *CurrentSession() const { return mSession.load(std::memory_order_acquire); }
+		// Makes session the current one (taking ownership of it)
+		void PublishSession(Session *session);
+		// Please acquire eventDomainsLock (for reading at least) before calling this!
+		EventDomain *FindEventDomain(const char *domain);
+		// Makes the event loop check right away whether the server can be reached
+		void ProbeEventLoop();
 
 		CCloudResult *LoginResultHandler(CCloudResult *result);
 		CCloudResult *LogoutResultHandler(CCloudResult *result);
@@ -245,6 +273,11 @@ namespace XtraLife {
 		 * @param url URL relative to the server (e.g. /api/login)
 		 */
 		CHttpRequest *MakeHttpRequest(const char *url);
+		/**
+		 * Builds the headers sent with every request: the application credentials, and the gamer ones if passed.
+		 * @param authorization value of the Authorization header, or NULL
+		 */
+		CHttpHeaders *MakeStaticHeaders(const char *authorization);
 	};
 	
 }
@@ -21,7 +21,10 @@ using namespace XtraLife::Helpers;
 
 // In seconds
 #define POP_REQUEST_RECOVER_TIMEOUT 2
-#define EVENT_THREAD_HOLD 20
+// In milliseconds: bounds of the delay before polling again a domain which failed, and spread of the domains when reconnecting
+#define EVENT_RETRY_BASE_DELAY 1000
+#define EVENT_RETRY_MAX_DELAY 20000
+#define EVENT_RECONNECT_SPREAD 500
 
 #ifndef __IOS__
 void endedPop() {}
@@ -30,17 +33,28 @@ void endedPop() {}
 namespace XtraLife {
 	
 	static singleton_holder<CClannishRESTProxy> managerSingleton;
+
+	/**
+	 * Credentials and profile of the logged in gamer. Not modified once published: logging in or out publishes a new one.
+	 */
+	struct CClannishRESTProxy::Session: CRefClass {
+		cstring gamerId, gamerSecret;
+		cstring network, networkId;
+		cstring displayName, email;
+		owned_ref<CHJSON> links;
+		// Headers of the requests, credentials included; NULL when logged out
+		autoref<CHttpHeaders> headers;
+
+		Session() { links <<= new CHJSON(); }
+	};
 	
-	CClannishRESTProxy::CClannishRESTProxy() {
+	CClannishRESTProxy::CClannishRESTProxy() : mSession(NULL), eventDomainsVersion(0) {
 		Init();
 		mRegisterForNotification = true;
-		mLinks = new CHJSON();
+		PublishSession(new Session);
 	}
 	
 	CClannishRESTProxy::~CClannishRESTProxy() {
-		// Terminate all running listeners
-		if (mLinks) delete mLinks;
-		mLinks = NULL;
 	}
 	
 	CClannishRESTProxy *CClannishRESTProxy::Instance() {
@@ -59,7 +73,15 @@ namespace XtraLife {
 	
 	bool CClannishRESTProxy::isLoggedIn()
 	{
-		return mGamerId != NULL;
+		return CurrentSession()->gamerId != NULL;
+	}
+
+	void CClannishRESTProxy::PublishSession(Session *session) {
+		CMutex::ScopedLock lock (mSessionsMutex);
+		autoref<Session> ref;
+		ref <<= session;
+		mSessions.push_back(ref);
+		mSession.store(session, std::memory_order_release);
 	}
 
 	void CClannishRESTProxy::SetNetworkState(bool on) {
@@ -70,6 +92,7 @@ namespace XtraLife {
 		// Network just got back! -> trigger pending requests if any
 		if (g_networkState && !previousState) {
 			http_trigger_pending();
+			ProbeEventLoop();
 		}
 	}
 
@@ -77,17 +100,17 @@ namespace XtraLife {
 		mSuspend = true;
 	}
 
-	void CClannishRESTProxy::Resume() {
-		mSuspend = false;
-		suspendedThreadLock.SignalAll();
-	}
-
-	const char *CClannishRESTProxy::GetGamerID() { return mGamerId; }
-	const char *CClannishRESTProxy::GetNetwork() { return mNetwork; }
-	const char *CClannishRESTProxy::GetNetworkID() { return mNetworkId; }
-	const char *CClannishRESTProxy::GetDisplayName() { return mDisplayName; }
-	const char *CClannishRESTProxy::GetMail() { return mEmail; }
+	const char *CClannishRESTProxy::GetGamerID() { return CurrentSession()->gamerId; }
+	const char *CClannishRESTProxy::GetNetwork() { return CurrentSession()->network; }
+	const char *CClannishRESTProxy::GetNetworkID() { return CurrentSession()->networkId; }
+	const char *CClannishRESTProxy::GetDisplayName() { return CurrentSession()->displayName; }
+	const char *CClannishRESTProxy::GetMail() { return CurrentSession()->email; }
 	const char *CClannishRESTProxy::GetAppID() { return mAppID; }
+
+	bool CClannishRESTProxy::isLinkedWith(const char *network) {
+		const Session *session = CurrentSession();
+		return IsEqual(session->network, network) || session->links->Has(network);
+	}
 		
 	void CClannishRESTProxy::Setup(const CHJSON *ajSON, CInternalResultHandler *onFinished) {
 		const char *env;
@@ -100,6 +123,8 @@ namespace XtraLife {
 		mAppVersion = ajSON->GetString("appVersion");
 		mSdkVersion = ajSON->GetString("sdkVersion");
 		mPopEventLoopDelay = ajSON->GetInt("eventLoopTimeout", 590);
+		mEventBatchSize = ajSON->GetInt("eventBatchSize", 1);
+		mEventTransport = ajSON->GetString("eventTransport", "longpoll");
 		env = ajSON->GetString("env");
 		mRegisterForNotification = ajSON->GetBool("autoRegisterForNotification", true);
 
@@ -117,12 +142,14 @@ namespace XtraLife {
 		if (!mApiKey || !mApiSecret || !env) {
 			return InvokeHandler(onFinished, enBadAppCredential, "Missing required parameter");
 		}
+		mAppHeaders <<= MakeStaticHeaders(NULL);
 
 		// Default to 5 sec for connection
 		int connectTimeout = ajSON->GetInt("connectTimeout", 5);
 		int httpTimeout = ajSON->GetInt("httpTimeout");
 		bool httpVerbose = ajSON->GetBool("httpVerbose");
 		http_init(env, lbCount, connectTimeout, httpTimeout, httpVerbose, &suspendedThreadLock);
+		CThreadPool::Configure(ajSON->GetInt("threadPoolSize"));
 		return InvokeHandler(onFinished, enNoErr);
 	}
 
@@ -171,16 +198,22 @@ namespace XtraLife {
 			// Extract meaningful info
 			const CHJSON *profileNode = rc->GetSafe("profile");
 			// Store the credentials for the next requests
-			mGamerId = rc->GetString("gamer_id");
-			mGamerSecret = rc->GetString("gamer_secret");
-			mNetwork = rc->GetString("network");
-			mNetworkId = rc->GetString("networkid");
-			if (mLinks) delete mLinks;
-			mLinks = rc->GetSafe("links")->Duplicate();
+			Session *session = new Session;
+			session->gamerId = rc->GetString("gamer_id");
+			session->gamerSecret = rc->GetString("gamer_secret");
+			session->network = rc->GetString("network");
+			session->networkId = rc->GetString("networkid");
+			session->links <<= rc->GetSafe("links")->Duplicate();
 			if (profileNode) {
-				mDisplayName = profileNode->GetString("displayName");
-				mEmail = profileNode->GetString("email");
+				session->displayName = profileNode->GetString("displayName");
+				session->email = profileNode->GetString("email");
+			}
+			if (session->gamerId) {
+				char basicAuthHeader[256];
+				make_basic_authentication_header(session->gamerId, session->gamerSecret, basicAuthHeader, safe::charsIn(basicAuthHeader));
+				session->headers <<= MakeStaticHeaders(basicAuthHeader);
 			}
+			PublishSession(session);
 			
 			mSuspend = false;
 			return result;
@@ -257,13 +290,7 @@ namespace XtraLife {
 	}
 	
 	CCloudResult *CClannishRESTProxy::LogoutResultHandler(CCloudResult *result) {
-		mGamerId = NULL;
-		mGamerSecret = NULL;
-		mDisplayName = NULL;
-		mEmail = NULL;
-		mNetwork = NULL;
-		if (mLinks) delete mLinks;
-		mLinks = new CHJSON();
+		PublishSession(new Session);
 		return result;
 	}
 	
@@ -335,7 +362,7 @@ namespace XtraLife {
 		CHttpRequest *req = MakeHttpRequest(url);
 		CHJSON json;
 		json.Put("score", aJSON->GetDouble("score"));
-		req->SetBody(json.Duplicate());
+		req->SetBody(std::move(json));
 		req->SetMethod("PUT");
 		req->SetCallback(MakeBridgeCallback(onFinished));
 		return http_perform(req);
@@ -354,7 +381,7 @@ namespace XtraLife {
 		CHJSON json;
 		json.Put("score", aJSON->GetDouble("score"));
 		json.Put("info", aJSON->GetString("info"));
-		req->SetBody(json.Duplicate());
+		req->SetBody(std::move(json));
 		req->SetCallback(MakeBridgeCallback(onFinished));
 		return http_perform(req);
 	}
@@ -1102,26 +1129,161 @@ namespace XtraLife {
 	}
 
 	/**
-	 * Pop command issuing thread. Launched when logged in and stopped when tearing down the clan.
+	 * Event loop of a domain. Its pop commands are issued by the EventLoopThread, along with those of the other domains.
 	 */
-	class CClannishRESTProxy::PopEventLoopThread: public CThread {
+	class CClannishRESTProxy::EventDomain: public CRefClass {
 		CClannishRESTProxy *self;
-		bool stopped;
-
-		bool AmIMainPopThread();
-		void KillThread();
 
 	public:
 		chain<CEventListener> listeners;
 		cstring domain;
-
-		PopEventLoopThread(CClannishRESTProxy *parent, const char *domain) : self(parent), stopped(false), domain(domain) { CONSOLE_VERBOSE("Creating pop event loop for domain %s\n", domain);
+		// Set from the main thread to have the event loop drop this domain
+		std::atomic<bool> stopped;
+		// Only accessed by the event loop thread
+		cstring messageToAcknowledge;
+		bool polling, lastResultPositive, lastResultNetworkError;
+		// The events of the current request are streamed rather than in its response
+		bool streamed;
+		std::chrono::steady_clock::time_point nextPollTime;
+		int retryDelay;			// last delay before polling again after a failure, in ms
+
+		EventDomain(CClannishRESTProxy *parent, const char *domain) : self(parent), domain(domain), stopped(false), polling(false), lastResultPositive(true), lastResultNetworkError(false), streamed(false), nextPollTime(std::chrono::steady_clock::now()), retryDelay(0) {
+			CONSOLE_VERBOSE("Creating pop event loop for domain %s\n", domain);
 		}
+		~EventDomain() { CONSOLE_VERBOSE("Removing event loop for %s\n", domain.c_str()); }
 		void AddListener(CEventListener *listener) { if (listener) { listeners.Add(listener); } }
 		void RemoveListener(CEventListener *listener) { if (listener) { listeners.Remove(listener); } }
+		bool IsMain() { return domain.IsEqual(ADMIN_EVENT_DOMAIN); }
+		CHttpRequest *MakePollRequest(std::atomic<bool> *cancellationFlag);
+		// Passes events (one, or an array of them) to the listeners
+		void Deliver(CCloudResult *events);
+		void ProcessResult(CCloudResult *result, std::chrono::steady_clock::time_point now);
+		void Kill();
+	};
+
+	/**
+	 * How the pop requests issued by the event loop receive the events, chosen with the "eventTransport" setup key.
+	 */
+	class CClannishRESTProxy::EventTransport {
+	public:
+		class LongPolling;
+		class ServerSentEvents;
+
+		virtual ~EventTransport() {}
+		// Adapts a pop request of the domain before it is issued
+		virtual void Prepare(EventDomain *domain, CHttpRequest *request) = 0;
+		static EventTransport *Make(const char *name);
+	};
+
+	/**
+	 * Each response holds the next event (or nothing after the timeout), a new request being issued right away.
+	 */
+	class CClannishRESTProxy::EventTransport::LongPolling: public CClannishRESTProxy::EventTransport {
+	public:
+		virtual void Prepare(EventDomain *, CHttpRequest *) {}
+	};
+
+	/**
+	 * The response stays open until the timeout and delivers the events as they come, as server-sent events whose data is
+	 * the JSON of an event. They are acknowledged by the next request. Servers which do not support it answer as for long polling.
+	 */
+	class CClannishRESTProxy::EventTransport::ServerSentEvents: public CClannishRESTProxy::EventTransport {
+		// Splits the stream into events; runs on the event loop thread
+		struct Parser: CHttpDataHandler {
+			EventDomain *domain;
+			std::vector<char> line, data;
+			cstring id;
+
+			Parser(EventDomain *domain) : domain(domain) {}
+			virtual bool OnBegin(const char *contentType) {
+				domain->streamed = !strncmp(contentType, "text/event-stream", 17);
+				line.clear();
+				data.clear();
+				return domain->streamed;
+			}
+			virtual bool OnData(const char *bytes, size_t length) {
+				for (size_t i = 0; i < length; i++) {
+					if (bytes[i] != '\n') {
+						if (bytes[i] != '\r') { line.push_back(bytes[i]); }
+						continue;
+					}
+					line.push_back(0);
+					Field(&line[0]);
+					line.clear();
+				}
+				return !domain->stopped;
+			}
+			void Field(const char *field) {
+				// An empty line ends the event, a line starting with a colon is a comment (keeping the connection alive)
+				if (!*field) { Dispatch(); return; }
+				if (*field == ':') { return; }
+				const char *colon = strchr(field, ':');
+				size_t nameLength = colon ? colon - field : strlen(field);
+				const char *value = colon ? colon + 1 : "";
+				if (*value == ' ') { value++; }
+				if (nameLength == 4 && !strncmp(field, "data", 4)) {
+					if (!data.empty()) { data.push_back('\n'); }
+					data.insert(data.end(), value, value + strlen(value));
+				} else if (nameLength == 2 && !strncmp(field, "id", 2)) {
+					id = value;
+				}
+			}
+			void Dispatch() {
+				if (data.empty()) { return; }
+				data.push_back(0);
+				CHJSON *json = CHJSON::parse(&data[0]);
+				data.clear();
+				if (!json) {
+					CONSOLE_WARNING("Ignoring malformed event for domain %s\n", domain->domain.c_str());
+					return;
+				}
+				domain->Deliver(new CCloudResult(enNoErr, json));
+				if (id) { domain->messageToAcknowledge = id; }
+			}
+		};
+
+	public:
+		virtual void Prepare(EventDomain *domain, CHttpRequest *request) {
+			request->SetHeader("Accept", "text/event-stream");
+			if (domain->messageToAcknowledge) {
+				request->SetHeader("Last-Event-ID", domain->messageToAcknowledge);
+			}
+			request->SetDataHandler(new Parser(domain));
+		}
+	};
+
+	CClannishRESTProxy::EventTransport *CClannishRESTProxy::EventTransport::Make(const char *name) {
+		if (IsEqual(name, "sse")) {
+			return new ServerSentEvents;
+		}
+		if (!IsEqual(name, "longpoll")) {
+			CONSOLE_WARNING("Unknown event transport %s, using long polling\n", name);
+		}
+		return new LongPolling;
+	}
+
+	/**
+	 * Pop command issuing thread, running the long polls of all domains at once. Launched when logged in and stopped when tearing down the clan.
+	 */
+	class CClannishRESTProxy::EventLoopThread: public CThread {
+		CClannishRESTProxy *self;
+		CHttpMultiplexer http;
+		owned_ref<EventTransport> transport;
+		// Set from the main thread
+		std::atomic<bool> stopped, probeRequested;
+		// Shared by all domains: while the network is down, only the main domain polls, as a probe for the others
+		bool networkDown;
+
+		void Reconnect(const std::vector< autoref<EventDomain> > &domains, std::chrono::steady_clock::time_point now);
+
+	public:
+		EventLoopThread(CClannishRESTProxy *parent) : self(parent), transport(EventTransport::Make(parent->mEventTransport)), stopped(false), probeRequested(false), networkDown(false) {}
 		virtual void Run();
-		void Terminate() { stopped = true; Join(); }
-		~PopEventLoopThread() { printf("Removing event loop for %s\n", domain.c_str()); }
+		// Makes the loop look at the domains again (added, removed, resumed)
+		void Wakeup() { http.Wakeup(); }
+		// Has the main domain poll right away, for instance when the network is known to be back
+		void Probe() { probeRequested = true; http.Wakeup(); }
+		void Terminate() { stopped = true; http.Wakeup(); Join(); }
 	};
 
 	eErrorCode CClannishRESTProxy::RegisterEventListener(const char *domain, CEventListener *listener) {
@@ -1131,23 +1293,29 @@ namespace XtraLife {
 		if (!domain) { return enBadParameters; }
 
 		// Already has this domain running?
-		CMutex::ScopedLock lock (popEventThreadMutex);
-		PopEventLoopThread *existingThread = FindEventThread(domain);
-		if (existingThread) {
+		CReadWriteLock::ScopedWriteLock lock (eventDomainsLock);
+		EventDomain *existingDomain = FindEventDomain(domain);
+		if (existingDomain) {
 			// Do not add twice in the list
-			FOR_EACH (CEventListener *l, existingThread->listeners) {
+			FOR_EACH (CEventListener *l, existingDomain->listeners) {
 				if (l == listener) {
 					return enEventListenerAlreadyRegistered;
 				}
 			}
-			existingThread->AddListener(listener);
+			existingDomain->AddListener(listener);
 		} else {
-			// Create a new thread
-			autoref<PopEventLoopThread> thread;
-			thread <<= new PopEventLoopThread(this, domain);
-			thread->AddListener(listener);
-			thread->Start();
-			popEventThreads.push_back(thread);
+			// Add a new domain to the event loop
+			autoref<EventDomain> eventDomain;
+			eventDomain <<= new EventDomain(this, domain);
+			eventDomain->AddListener(listener);
+			eventDomains[eventDomain->domain] = eventDomain;
+			eventDomainsVersion++;
+			if (!eventLoop) {
+				eventLoop <<= new EventLoopThread(this);
+				eventLoop->Start();
+			} else {
+				eventLoop->Wakeup();
+			}
 		}
 		return enNoErr;
 	}
@@ -1157,38 +1325,51 @@ namespace XtraLife {
 		if (!isSetup()) { return enSetupNotCalled; }
 
 		// Try to find the handler
-		CMutex::ConditionallyScopedLock lock (popEventThreadMutex, acquireLock);
-		PopEventLoopThread *thread = FindEventThread(domain);
-		if (!thread) { return enNoErr; }
+		CReadWriteLock::ConditionallyScopedWriteLock lock (eventDomainsLock, acquireLock);
+		EventDomain *eventDomain = FindEventDomain(domain);
+		if (!eventDomain) { return enNoErr; }
 
 		// Remove listener
-		thread->RemoveListener(listener);
+		eventDomain->RemoveListener(listener);
 		// And remove the entry as well if no more listeners are registered
-		if (thread->listeners.isEmpty()) {
-			/**
-			 * We do not wait on the thread, if it is currently running a request, it will
-			 * continue until timeout, see shouldStop, discard the response and terminate.
-			 */
-			thread->Terminate();
-			popEventThreads.erase(std::remove(popEventThreads.begin(), popEventThreads.end(), thread), popEventThreads.end());
+		if (eventDomain->listeners.isEmpty()) {
+			// The event loop aborts the pop request of the domain, if any, as soon as it wakes up
+			eventDomain->stopped = true;
+			// Erasing may release the last reference to the domain
+			autoref<EventDomain> removed(eventDomain);
+			eventDomains.erase(eventDomain->domain);
+			eventDomainsVersion++;
+			if (eventLoop) {
+				eventLoop->Wakeup();
+			}
 		}
 		return enNoErr;
 	}
 
-	CClannishRESTProxy::PopEventLoopThread *CClannishRESTProxy::FindEventThread(const char *domain) {
-		FOR_EACH (PopEventLoopThread *t, popEventThreads) {
-			if (t->domain.IsEqual(domain)) {
-				return t;
-			}
+	CClannishRESTProxy::EventDomain *CClannishRESTProxy::FindEventDomain(const char *domain) {
+		if (!domain) { return NULL; }
+		auto it = eventDomains.find(cstring(domain));
+		return it != eventDomains.end() ? (EventDomain*) it->second : NULL;
+	}
+
+	size_t CClannishRESTProxy::EventDomainHash::operator () (const cstring &domain) const {
+		// FNV-1a, as for the keys of CHJSON objects
+		size_t hash = 2166136261u;
+		for (const char *c = domain; c && *c; c++) {
+			hash = (hash ^ (unsigned char) *c) * 16777619u;
 		}
-		return NULL;
+		return hash;
 	}
 
-	void CClannishRESTProxy::PopEventLoopThread::KillThread() {
-		CMutex::ScopedLock lock (self->popEventThreadMutex);
-		CONSOLE_WARNING("Killing thread for domain %s because of a network error\n", domain.c_str());
-		// Removing all listeners will make the main code stop this thread
+	void CClannishRESTProxy::EventDomain::Kill() {
+		CReadWriteLock::ScopedWriteLock lock (self->eventDomainsLock);
+		CONSOLE_WARNING("Killing event loop for domain %s because of a network error\n", domain.c_str());
+		// Removing all listeners will make the main code stop this domain (the chain is modified along the way, so go through a copy)
+		std::vector< autoref<CEventListener> > toRemove;
 		FOR_EACH (CEventListener *l, listeners) {
+			toRemove.push_back(autoref<CEventListener>(l));
+		}
+		FOR_EACH (CEventListener *l, toRemove) {
 			self->UnregisterEventListener(domain, l, false);
 		}
 	}
@@ -1198,152 +1379,298 @@ namespace XtraLife {
 	}
 
 	void CClannishRESTProxy::StopEventListening() {
-		CMutex::ScopedLock lock (popEventThreadMutex);
-		// Unregister all event listeners and free memory
-		FOR_EACH (PopEventLoopThread *t, popEventThreads) {
-			t->Terminate();
+		autoref<EventLoopThread> loop;
+		{
+			CReadWriteLock::ScopedWriteLock lock (eventDomainsLock);
+			for (auto &entry : eventDomains) {
+				entry.second->stopped = true;
+			}
+			eventDomains.clear();
+			eventDomainsVersion++;
+			loop = eventLoop;
+			eventLoop <<= NULL;
+		}
+		// Wait for the pending requests to be aborted (out of the lock, which the loop takes)
+		if (loop) {
+			loop->Terminate();
 		}
-		// This doesn't actually end the threads; but removes them from the list (they still have a refcount > 0 because they retain themselves while running).
-		// So they will be released when the thread finishes, we just won't interact with them anymore and let them die.
-		popEventThreads.clear();
 	}
 
-	bool CClannishRESTProxy::PopEventLoopThread::AmIMainPopThread() {
-		return domain.IsEqual(ADMIN_EVENT_DOMAIN);
+	void CClannishRESTProxy::Resume() {
+		mSuspend = false;
+		suspendedThreadLock.LockVar();
+		suspendedThreadLock.SignalAll();
+		suspendedThreadLock.UnlockVar();
+		ProbeEventLoop();
 	}
 
-	void CClannishRESTProxy::PopEventLoopThread::Run() {
-		cstring messageToAcknowledge;
-		bool lastResultPositive = true, lastResultNetworkError = false, mainThread = AmIMainPopThread();
-		owned_ref<CCloudResult> lastResult;
+	void CClannishRESTProxy::ProbeEventLoop() {
+		CReadWriteLock::ScopedReadLock lock (eventDomainsLock);
+		if (eventLoop) {
+			eventLoop->Probe();
+		}
+	}
 
-		// Thread end condition
-		while (!stopped) {
-			int delay = self->mPopEventLoopDelay;
-			// On hold
-			if (self->mSuspend) {
-				CONSOLE_VERBOSE("Suspending pop thread %s\n", domain.c_str());
-				self->suspendedThreadLock.Wait();
-				// Wait between 0 to 5 sec to avoid all threads to wake up at the same time
-				if (!AmIMainPopThread()) {
-					std::this_thread::sleep_for(std::chrono::milliseconds((rand() % 50) * 100));
+	CHttpRequest *CClannishRESTProxy::EventDomain::MakePollRequest(std::atomic<bool> *cancellationFlag) {
+		int delay = self->mPopEventLoopDelay;
+		if (!lastResultPositive && IsMain()) {
+			// On the main domain, try again with a smaller timeout so that we can notify that the network is back as soon as the server is reached
+			delay = POP_REQUEST_RECOVER_TIMEOUT;
+		}
+
+		// Determine URL
+		CUrlBuilder url("/v1/gamer/event");
+		url.Subpath(domain).QueryParam("timeout", delay * 1000);
+		if (messageToAcknowledge) {
+			url.QueryParam("ack", messageToAcknowledge.c_str());
+		}
+		if (self->mEventBatchSize > 1) {
+			url.QueryParam("limit", self->mEventBatchSize);
+		}
+		CONSOLE_VERBOSE("Pop request to %s\n", url.BuildUrl());
+
+		CHttpRequest *req = self->MakeHttpRequest(url);
+		streamed = false;
+		req->SetCancellationFlag(cancellationFlag);
+		req->SetMethod("GET");
+		// Failures are retried by the event loop, with its own backoff, which Probe() can cut short
+		req->SetRetryPolicy(CHttpRequest::Never);
+		req->SetTimeout(delay + 30);
+		return req;
+	}
+
+	void CClannishRESTProxy::EventDomain::Deliver(CCloudResult *events) {
+		owned_ref<CCloudResult> result(events);
+		const CHJSON *json = result->GetJSON();
+		if (json->type() == CHJSON::jsonArray) {
+			// Several events at once (see eventBatchSize): all of them are acknowledged by the next request
+			cstring ids, previous;
+			FOR_EACH (const CHJSON *event, *json) {
+				const char *id = event->GetString("id");
+				if (!id || !*id) { continue; }
+				previous = ids;
+				csprintf(ids, previous ? "%s,%s" : "%s%s", previous ? previous.c_str() : "", id);
+			}
+			messageToAcknowledge = ids;
+		} else {
+			messageToAcknowledge = json->GetString("id");
+		}
+		// Notify events on main thread, all in one callback
+		struct NotifyEvent: CCallback {
+			_BLOCK1(NotifyEvent, CCallback, autoref<EventDomain>, self);
+			void Done(const CCloudResult *result) {
+				if (result->GetJSON()->type() != CHJSON::jsonArray) {
+					Notify(result);
+					return;
+				}
+				FOR_EACH (const CHJSON *event, *result->GetJSON()) {
+					CCloudResult single(enNoErr, event->Duplicate());
+					Notify(&single);
+				}
+			}
+			void Notify(const CCloudResult *event) {
+				FOR_EACH (CEventListener *l, self->listeners) {
+					l->onEventReceived(self->domain, event);
 				}
-				continue;
 			}
+		};
+		if (json->type() != CHJSON::jsonArray || json->size() > 0) {
+			CallbackStack::pushCallback(new NotifyEvent(autoref<EventDomain>(this)), result.detachOwnership());
+		}
+	}
 
-			// Process last request
-			if (lastResult) {
-				int status = lastResult->GetHttpStatusCode();
-				// Chris request: sometimes ngnix returns a 499 instead of a 204 in case of timeout
-				if (status == 499) { status = 204; }
-				bool success = lastResult->GetErrorCode() == enNoErr && status < 300;
-				bool networkError = (lastResult->GetErrorCode() == enNetworkError);
-
-				// Network state notifications (on main thread). Unlike normal notifications, only notify actual network errors (not 5xx and such).
-				if (mainThread) {
-					struct SetNetworkThread: CCallback {
-						_BLOCK1(SetNetworkThread, CCallback, CClannishRESTProxy*, self);
-						void Done(const CCloudResult *result) {
-							self->SetNetworkState(result->GetErrorCode() == enNoErr);
-						}
-					};
-					// Run on main thread
-					if (networkError != lastResultNetworkError) {
-						CallbackStack::pushCallback(new SetNetworkThread(self), new CCloudResult(lastResult->GetErrorCode()));
-					}
+	void CClannishRESTProxy::EventDomain::ProcessResult(CCloudResult *result, std::chrono::steady_clock::time_point now) {
+		owned_ref<CCloudResult> lastResult(result);
+		int status = lastResult->GetHttpStatusCode();
+		// Chris request: sometimes ngnix returns a 499 instead of a 204 in case of timeout
+		if (status == 499) { status = 204; }
+		// The events of a stream have been delivered as they came
+		if (status == 200 && streamed) { status = 204; }
+		bool success = lastResult->GetErrorCode() == enNoErr && status < 300;
+		bool networkError = (lastResult->GetErrorCode() == enNetworkError);
+
+		// Network state notifications (on main domain). Unlike normal notifications, only notify actual network errors (not 5xx and such).
+		if (IsMain()) {
+			struct SetNetworkThread: CCallback {
+				_BLOCK1(SetNetworkThread, CCallback, CClannishRESTProxy*, self);
+				void Done(const CCloudResult *result) {
+					self->SetNetworkState(result->GetErrorCode() == enNoErr);
 				}
+			};
+			// Run on main thread
+			if (networkError != lastResultNetworkError) {
+				CallbackStack::pushCallback(new SetNetworkThread(self), new CCloudResult(lastResult->GetErrorCode()));
+			}
+		}
 
-				if (status == 200) {
-					messageToAcknowledge = lastResult->GetJSON()->GetString("id");
-					// Notify event on main thread
-					struct NotifyEvent: CCallback {
-						_BLOCK1(NotifyEvent, CCallback, PopEventLoopThread*, self);
-						void Done(const CCloudResult *result) {
-							FOR_EACH (CEventListener *l, self->listeners) {
-								l->onEventReceived(self->domain, result);
-							}
-						}
-					};
-					CallbackStack::pushCallback(new NotifyEvent(this), lastResult.detachOwnership());
+		if (status == 200) {
+			Deliver(lastResult.detachOwnership());
+		}
+		else if (status != 204 && lastResultPositive) {
+			// Non retriable error -> kill ourselves
+			bool needKill = (status >= 400 && status < 500);
+			// Signal errors (do not signal multiple failures to avoid spam when offline)
+			struct NotifyEvent: CCallback {
+				_BLOCK3(NotifyEvent, CCallback,
+					autoref<EventDomain>, self,
+					eErrorCode, code,
+					bool, killAfterwards);
+				void Done(const CCloudResult *result) {
+					// Notify
+					FOR_EACH (CEventListener *l, self->listeners) {
+						l->onEventError(code, self->domain, result);
+					}
+					// And kill if needed
+					if (killAfterwards) {
+						self->Kill();
+					}
 				}
-				else if (status != 204 && lastResultPositive) {
-					// Non retriable error -> kill ourselves
-					bool needKill = (status >= 400 && status < 500);
-					// Signal errors (do not signal multiple failures to avoid spam when offline)
-					struct NotifyEvent: CCallback {
-						_BLOCK3(NotifyEvent, CCallback,
-							PopEventLoopThread*, self,
-							eErrorCode, code,
-							bool, killAfterwards);
-						void Done(const CCloudResult *result) {
-							// Notify
-							FOR_EACH (CEventListener *l, self->listeners) {
-								l->onEventError(code, self->domain, result);
-							}
-							// And kill if needed
-							if (killAfterwards) {
-								self->KillThread();
-							}
-						}
-					};
-					CallbackStack::pushCallback(new NotifyEvent(this, enServerError, needKill), new CCloudResult(enServerError, lastResult->GetJSON()->Duplicate()));
+			};
+			CallbackStack::pushCallback(new NotifyEvent(autoref<EventDomain>(this), enServerError, needKill), new CCloudResult(enServerError, lastResult->GetJSON()->Duplicate()));
+		}
+		lastResultPositive = success;
+		lastResultNetworkError = networkError;
+
+		nextPollTime = now;
+		if (lastResultPositive) {
+			retryDelay = 0;
+		} else {
+			// Back off exponentially to avoid bombing the poor internet, with decorrelated jitter so that domains (and clients) spread out
+			int upper = (retryDelay > EVENT_RETRY_BASE_DELAY ? retryDelay : EVENT_RETRY_BASE_DELAY) * 3;
+			retryDelay = EVENT_RETRY_BASE_DELAY + rand() % (upper - EVENT_RETRY_BASE_DELAY + 1);
+			if (retryDelay > EVENT_RETRY_MAX_DELAY) { retryDelay = EVENT_RETRY_MAX_DELAY; }
+			CONSOLE_VERBOSE("Event loop for domain %s put on hold for %dms\n", domain.c_str(), retryDelay);
+			nextPollTime += std::chrono::milliseconds(retryDelay);
+		}
+	}
+
+	void CClannishRESTProxy::EventLoopThread::Reconnect(const std::vector< autoref<EventDomain> > &domains, std::chrono::steady_clock::time_point now) {
+		// The main domain polls right away, the others shortly after, at random so as not to hit the server all at once
+		FOR_EACH (EventDomain *d, domains) {
+			std::chrono::steady_clock::time_point time = now + std::chrono::milliseconds(d->IsMain() ? 0 : rand() % EVENT_RECONNECT_SPREAD);
+			if (!d->polling && d->nextPollTime > time) {
+				d->nextPollTime = time;
+				d->retryDelay = 0;
+			}
+		}
+	}
+
+	void CClannishRESTProxy::EventLoopThread::Run() {
+		typedef std::chrono::steady_clock clock;
+		std::vector< autoref<EventDomain> > domains, polling;
+		unsigned domainsVersion = 0;
+		bool wasSuspended = false;
+
+		// Thread end condition
+		while (!stopped) {
+			// Domains are added and removed from the main thread
+			if (domains.empty() || domainsVersion != self->eventDomainsVersion) {
+				CReadWriteLock::ScopedReadLock lock (self->eventDomainsLock);
+				domainsVersion = self->eventDomainsVersion;
+				domains.clear();
+				for (auto &entry : self->eventDomains) {
+					domains.push_back(entry.second);
 				}
-				lastResultPositive = success;
-				lastResultNetworkError = networkError;
-				lastResult <<= NULL;
 			}
 
-			if (!lastResultPositive) {
-				// Network down -- wait 20 sec to avoid bombing the poor internet
-				CONSOLE_VERBOSE("Event thread for domain %s put on hold for %ds\n", domain.c_str(), EVENT_THREAD_HOLD);
-				self->suspendedThreadLock.Wait(EVENT_THREAD_HOLD * 1000);
-				if (mainThread) {
-					// On the main thread, try again with a smaller timeout so that we can notify that the network is back as soon as the server is reached
-					delay = POP_REQUEST_RECOVER_TIMEOUT;
+			// Abort the requests of the domains which have been removed, their response is of no use
+			for (size_t i = 0; i < polling.size(); ) {
+				if (polling[i]->stopped) {
+					http.Abort(polling[i]);
+					polling[i]->polling = false;
+					polling.erase(polling.begin() + i);
+				} else {
+					i++;
 				}
-				// Do only continue if it still makes sense after the wait
-				if (stopped) { break; }
-				if (self->mSuspend) { continue; }
 			}
 
-			// Determine URL
-			CUrlBuilder url("/v1/gamer/event");
-			url.Subpath(domain).QueryParam("timeout", delay * 1000);
-			if (messageToAcknowledge) {
-				url.QueryParam("ack", messageToAcknowledge.c_str());
+			clock::time_point now = clock::now();
+			bool suspended = self->mSuspend, hasMain = false;
+			if (suspended && !wasSuspended) {
+				CONSOLE_VERBOSE("Suspending event loop\n");
+			}
+			wasSuspended = suspended;
+			FOR_EACH (EventDomain *d, domains) {
+				hasMain = hasMain || d->IsMain();
+			}
+			// Resumed or network back: check whether the server is reachable without waiting for the end of the backoff
+			if (probeRequested && !suspended) {
+				probeRequested = false;
+				Reconnect(domains, now);
+			}
+
+			// Issue the pop requests which are due, and wake up in time for the next ones
+			int wait = self->mPopEventLoopDelay * 1000;
+			FOR_EACH (EventDomain *d, domains) {
+				if (d->polling || d->stopped || suspended) { continue; }
+				// Wait for the main domain to reach the server
+				if (networkDown && hasMain && !d->IsMain()) { continue; }
+				if (d->nextPollTime <= now) {
+					d->polling = true;
+					polling.push_back(autoref<EventDomain>(d));
+					CHttpRequest *req = d->MakePollRequest(&stopped);
+					transport->Prepare(d, req);
+					http.Add(req, d);
+				} else {
+					int delay = (int) std::chrono::duration_cast<std::chrono::milliseconds>(d->nextPollTime - now).count() + 1;
+					if (delay < wait) { wait = delay; }
+				}
 			}
-			CONSOLE_VERBOSE("Pop request to %s\n", url.BuildUrl());
-
-			// Blocking pop request
-			CHttpRequest *req = self->MakeHttpRequest(url);
-			req->SetCancellationFlag(&stopped);
-			req->SetMethod("GET");
-			req->SetRetryPolicy(CHttpRequest::NonpermanentErrors);
-			req->SetTimeout(delay + 30);
-			lastResult <<= http_perform_synchronous(req);
-
-			// If the thread has been requested to terminate, don't process the response (CURLE_ABORTED_BY_CALLBACK = 42)
-			if (lastResult->GetCurlErrorCode() == 42) {
-				stopped = true;
+
+			http.Perform(wait);
+
+			void *cookie;
+			while (CCloudResult *result = http.Completed(cookie)) {
+				EventDomain *d = (EventDomain*) cookie;
+				// If the thread has been requested to terminate, don't process the response (CURLE_ABORTED_BY_CALLBACK = 42)
+				if (result->GetCurlErrorCode() == 42) {
+					stopped = true;
+				}
+				d->polling = false;
+				if (stopped || d->stopped) {
+					delete result;
+				} else {
+					now = clock::now();
+					d->ProcessResult(result, now);
+					if (d->lastResultNetworkError) {
+						networkDown = true;
+					} else if (networkDown) {
+						// The server is reachable again, release the domains held meanwhile
+						networkDown = false;
+						Reconnect(domains, now);
+					}
+				}
+				polling.erase(std::remove(polling.begin(), polling.end(), d), polling.end());
 			}
 		}
+
+		FOR_EACH (EventDomain *d, polling) {
+			http.Abort(d);
+		}
 	}
 
 	CHttpRequest * CClannishRESTProxy::MakeUnauthenticatedHttpRequest(const char *url) {
 		CHttpRequest *result = new CHttpRequest(url);
-		result->SetHeader("x-apikey", mApiKey);
-		result->SetHeader("x-apisecret", mApiSecret);
-		result->SetHeader("x-sdkversion", mSdkVersion);
+		result->SetSharedHeaders(mAppHeaders);
 		return result;
 	}
 
 	CHttpRequest * CClannishRESTProxy::MakeHttpRequest(const char *url) {
-		CHttpRequest *result = MakeUnauthenticatedHttpRequest(url);
-		char basicAuthHeader[256];
-		// Add basic authentication
-		if (isLoggedIn()) {
-			make_basic_authentication_header(mGamerId, mGamerSecret, basicAuthHeader, safe::charsIn(basicAuthHeader));
-			result->SetHeader("Authorization", basicAuthHeader);
+		// The session headers include basic authentication
+		const Session *session = CurrentSession();
+		if (!session->headers) { return MakeUnauthenticatedHttpRequest(url); }
+		CHttpRequest *result = new CHttpRequest(url);
+		result->SetSharedHeaders(session->headers);
+		return result;
+	}
+
+	CHttpHeaders *CClannishRESTProxy::MakeStaticHeaders(const char *authorization) {
+		CHttpHeaders *result = new CHttpHeaders;
+		result->Add("x-apikey", mApiKey);
+		result->Add("x-apisecret", mApiSecret);
+		result->Add("x-sdkversion", mSdkVersion);
+		if (authorization) {
+			result->Add("Authorization", authorization);
 		}
 		return result;
 	}
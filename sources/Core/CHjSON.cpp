@@ -6,6 +6,9 @@
 //  Copyright 2011 Clan of the Cloud. All rights reserved.
 //
 
+#include <limits.h>
+#include <stdio.h>
+
 #include "include/CHJSON.h"
 #include "ExternalModules/cJSON/cJSON.h"
 #include "include/XtraLifeHelpers.h"
@@ -18,28 +21,66 @@ namespace XtraLife {
     // ------------------
         static CHJSON *emptyOne;
 
+        // Chain of malloc'd buffers that in-situ parsed nodes point to (along with the tape indexing it, if lazily
+        // parsed); freed along with the tree
+        struct CBackingStore {
+            char *buffer;
+            cJSON_Tape *tape;
+            CBackingStore *next;
+        };
+
+        // The node this object stands for: the tree node, or for a lazy one, its value decoded into scratch
+        const cJSON *CHJSON::node(cJSON &scratch) const {
+            if (mTapeIndex < 0) { return mJSON; }
+            cJSON_TapeValue(mTape, mTapeIndex, &scratch);
+            return &scratch;
+        }
+
+        // Same for the value associated to key in this object, NULL if there is none
+        const cJSON *CHJSON::lookup(const char *key, cJSON &scratch) const {
+            if (mTapeIndex >= 0) {
+                int index = cJSON_TapeObjectItem(mTape, mTapeIndex, key);
+                if (index >= 0) {
+                    cJSON_TapeValue(mTape, index, &scratch);
+                    return &scratch;
+                }
+            }
+            return mJSON ? cJSON_GetObjectItem(mJSON, key) : NULL;
+        }
+
         const char *CHJSON::name() const {
-            return mJSON->string;
+            return mTapeIndex >= 0 ? cJSON_TapeName(mTape, mTapeIndex) : mJSON->string;
         }
         
         CHJSON::jsonType CHJSON::type() const {
-            return (CHJSON::jsonType) mJSON->type;
+            return (CHJSON::jsonType) (mTapeIndex >= 0 ? cJSON_TapeType(mTape, mTapeIndex) : mJSON->type & 255);
         }
         
         const char *CHJSON::valueString() const {
-            return mJSON->valuestring;
+            cJSON scratch;
+            return node(scratch)->valuestring;
         }
         
         int CHJSON::valueInt() const  {
-            return mJSON->valueint;
+            cJSON scratch;
+            return node(scratch)->valueint;
+        }
+        
+        long long CHJSON::valueInt64() const  {
+            cJSON scratch;
+            return node(scratch)->valueint64;
         }
         
         double CHJSON::valueDouble() const {
-            return mJSON->valuedouble;
+            cJSON scratch;
+            return node(scratch)->valuedouble;
         }
 
         CHJSON::CHJSON() {
             mNext = NULL;
+            mBacking = NULL;
+            mTape = NULL;
+            mTapeIndex = -1;
             release = true;
             mJSON = cJSON_CreateObject();
         }
@@ -48,18 +89,20 @@ namespace XtraLife {
             release = torelease;
             mJSON = json;
             mNext = NULL;
+            mBacking = NULL;
+            mTape = NULL;
+            mTapeIndex = -1;
         }
 
         CHJSON *CHJSON::dup(const CHJSON *json)
         {
-            // slow version
             if (json == NULL)
                 return new CHJSON();
-                
-            char *jsonstring = cJSON_PrintUnformatted(json->mJSON);
-            CHJSON *newjson = CHJSON::parse(jsonstring);
-            free(jsonstring);
-            return newjson;
+
+            cJSON *last, *tree = json->borrowTree(last);
+            cJSON *copy = cJSON_Duplicate(tree, 1);
+            json->returnTree(tree, last);
+            return copy ? new CHJSON(copy, true) : NULL;
         }
 
         CHJSON *CHJSON::Duplicate() const {
@@ -72,6 +115,29 @@ namespace XtraLife {
             mNext = json;
         }
 
+        void CHJSON::adopt(CHJSON *json)
+        {
+            // Nodes of json are about to join our tree, so must the buffers they point to
+            CBackingStore *last = json->mBacking;
+            if (!last) { return; }
+            while (last->next) { last = last->next; }
+            last->next = mBacking;
+            mBacking = json->mBacking;
+            json->mBacking = NULL;
+        }
+
+        void CHJSON::releaseBackingStore()
+        {
+            while (mBacking)
+            {
+                CBackingStore *next = mBacking->next;
+                free(mBacking->buffer);
+                cJSON_TapeDelete(mBacking->tape);
+                delete mBacking;
+                mBacking = next;
+            }
+        }
+
         void CHJSON::garbage() const
         {
             CHJSON *p = mNext;
@@ -84,18 +150,55 @@ namespace XtraLife {
             }
         }
         
+        CHJSON::CHJSON(CHJSON &&other)
+        {
+            mJSON = NULL;
+            mNext = NULL;
+            mBacking = NULL;
+            release = false;
+            *this = std::move(other);
+        }
+
+        CHJSON& CHJSON::operator = (CHJSON &&other)
+        {
+            if (this == &other) { return *this; }
+            this->garbage();
+            if (release) {
+                cJSON_Delete(mJSON);
+                releaseBackingStore();
+            }
+            // Take everything over, views included, and leave other as an empty object
+            mJSON = other.mJSON;
+            mNext = other.mNext;
+            mBacking = other.mBacking;
+            release = other.release;
+            mTape = other.mTape;
+            mTapeIndex = other.mTapeIndex;
+            other.mNext = NULL;
+            other.mBacking = NULL;
+            other.mTape = NULL;
+            other.mTapeIndex = -1;
+            other.release = true;
+            other.mJSON = cJSON_CreateObject();
+            return *this;
+        }
+
         CHJSON::~CHJSON()
         {
             this->garbage();
             if (release)
             {
                 cJSON_Delete(mJSON);
+                releaseBackingStore();
             }
         }
 
         CHJSON::CHJSON(bool b)
         {
             mNext = NULL;
+            mBacking = NULL;
+            mTape = NULL;
+            mTapeIndex = -1;
             release = true;
             mJSON = cJSON_CreateBool(b);
         }
@@ -103,6 +206,9 @@ namespace XtraLife {
         CHJSON::CHJSON(double num)
         {
             mNext = NULL;
+            mBacking = NULL;
+            mTape = NULL;
+            mTapeIndex = -1;
             release = true;
             mJSON = cJSON_CreateNumber(num);
         }
@@ -110,6 +216,9 @@ namespace XtraLife {
         CHJSON::CHJSON(const char *string)
         {
             mNext = NULL;
+            mBacking = NULL;
+            mTape = NULL;
+            mTapeIndex = -1;
             release = true;
             mJSON = cJSON_CreateString(string);
         }
@@ -172,98 +281,266 @@ namespace XtraLife {
 
 
         int CHJSON::size() const {
+            if (mTapeIndex >= 0) {
+                return cJSON_TapeSize(mTape, mTapeIndex) + (mJSON ? cJSON_GetArraySize(mJSON) : 0);
+            }
             return cJSON_GetArraySize(mJSON);
         }
 
+        // Lazy nodes are turned into a tree before being modified, unless the key to be written is new to a lazy object:
+        // it then goes to the side tree (which avoids decoding a response just to put the status in it, see CCloudResult).
+        void CHJSON::makeWritable(const char *key)
+        {
+            if (mTapeIndex < 0) { return; }
+            if (key && cJSON_TapeType(mTape, mTapeIndex) == cJSON_Object && cJSON_TapeObjectItem(mTape, mTapeIndex, key) < 0) {
+                if (!mJSON) { mJSON = cJSON_CreateObject(); }
+                return;
+            }
+
+            cJSON *tree = cJSON_TapeToTree(mTape, mTapeIndex);
+            if (mJSON) {
+                // Move the keys kept aside to the end of the tree
+                cJSON_AddItemsToArray(tree, mJSON);
+                cJSON_Delete(mJSON);
+            }
+            // Views handed out before keep working: the tape lives as long as the backing store. A view modified through
+            // a cast gets a tree of its own.
+            mJSON = tree;
+            mTapeIndex = -1;
+            release = true;
+        }
+
         void CHJSON::Add(CHJSON *json)
         {
+            makeWritable();
+            json->makeWritable();
             json->release = false;
+            adopt(json);
             cJSON_AddItemToArray(mJSON, json->mJSON);
             delete json;
         }
 
         void CHJSON::Add(const char *item, CHJSON *json)
         {
+            makeWritable(item);
+            json->makeWritable();
             json->release = false;
+            adopt(json);
             cJSON_AddItemToObject(mJSON, item, json->mJSON);
             delete json;
         }
         
         void CHJSON::Replace(const char *item, CHJSON *json)
         {
+            makeWritable(item);
+            json->makeWritable();
             json->release = false;
+            adopt(json);
             cJSON_ReplaceItemInObject(mJSON, item, json->mJSON);
             delete json;
         }
 
-        const CHJSON *CHJSON::Get(const char *item) const
+        // Read-only object standing for a value of our tape
+        const CHJSON *CHJSON::view(int tapeIndex) const
         {
-            cJSON *cj = cJSON_GetObjectItem(mJSON, item);
-            if(cj == NULL)
-                return NULL;
-            
-            CHJSON *json = new CHJSON(cj, false);
+            CHJSON *json = new CHJSON(NULL, false);
+            json->mTape = mTape;
+            json->mTapeIndex = tapeIndex;
             push(json);
             return json;
         }
-        
-        const CHJSON *CHJSON::Get(int index) const
+
+        // Object standing for a node of our tree, or of our tape if tapeIndex >= 0, released along with us
+        const CHJSON *CHJSON::wrap(cJSON *node, int tapeIndex) const
         {
-            cJSON *cj =  cJSON_GetArrayItem(mJSON, index);
-            if (cj == NULL)
-                return NULL;
-            
-            CHJSON *json = new CHJSON(cj, false);
+            if (tapeIndex >= 0) { return view(tapeIndex); }
+            CHJSON *json = new CHJSON(node, false);
             push(json);
             return json;
         }
 
+        const CHJSON *CHJSON::Get(const char *item) const
+        {
+            if (mTapeIndex >= 0) {
+                int index = cJSON_TapeObjectItem(mTape, mTapeIndex, item);
+                if (index >= 0) { return view(index); }
+            }
+            cJSON *cj = mJSON ? cJSON_GetObjectItem(mJSON, item) : NULL;
+            return cj ? wrap(cj, -1) : NULL;
+        }
+        
+        const CHJSON *CHJSON::Get(int index) const
+        {
+            if (mTapeIndex >= 0) {
+                int count = cJSON_TapeSize(mTape, mTapeIndex);
+                if (index < count) {
+                    int item = cJSON_TapeArrayItem(mTape, mTapeIndex, index);
+                    return item >= 0 ? view(item) : NULL;
+                }
+                index -= count;
+            }
+            cJSON *cj = mJSON ? cJSON_GetArrayItem(mJSON, index) : NULL;
+            return cj ? wrap(cj, -1) : NULL;
+        }
+
         double CHJSON::GetDouble(const char *item, double defaultValue) const
         {
-            cJSON *cj = cJSON_GetObjectItem(mJSON, item);
-            return (cj && cj->type==jsonNumber) ? cj->valuedouble : defaultValue;
+            cJSON scratch;
+            const cJSON *cj = lookup(item, scratch);
+            return (cj && (cj->type & 255)==jsonNumber) ? cj->valuedouble : defaultValue;
         }
         
         int CHJSON::GetInt(const char *item, int defaultValue) const
         {
-            cJSON *cj = cJSON_GetObjectItem(mJSON, item);
-            return (cj && cj->type==jsonNumber) ? cj->valueint : defaultValue;
+            cJSON scratch;
+            const cJSON *cj = lookup(item, scratch);
+            return (cj && (cj->type & 255)==jsonNumber) ? cj->valueint : defaultValue;
+        }
+
+        long long CHJSON::GetInt64(const char *item, long long defaultValue) const
+        {
+            cJSON scratch;
+            const cJSON *cj = lookup(item, scratch);
+            return (cj && (cj->type & 255)==jsonNumber) ? cj->valueint64 : defaultValue;
         }
 
         bool CHJSON::GetBool(const char *item, bool defaultValue) const
         {
-            cJSON *cj = cJSON_GetObjectItem(mJSON, item);
-            return cj ? cj->type == jsonTrue : defaultValue;
+            cJSON scratch;
+            const cJSON *cj = lookup(item, scratch);
+            return cj ? (cj->type & 255) == jsonTrue : defaultValue;
         }
 
         CHJSON *CHJSON::parse(const char *jsonString)
         {
-            cJSON *json = cJSON_Parse(jsonString);
+            // Called concurrently from the HTTP and event threads: keep the parser state on the stack
+            cJSON_Context context;
+            memset(&context, 0, sizeof(context));
+            cJSON *json = cJSON_ParseWithContext(jsonString, &context);
             if (json)
                 return new CHJSON(json, true);
             else
                 return NULL;
         }
+
+        CHJSON *CHJSON::parseInSitu(char *buffer)
+        {
+            cJSON_Context context;
+            memset(&context, 0, sizeof(context));
+            cJSON *json = cJSON_ParseInSituWithContext(buffer, &context);
+            if (!json) {
+                free(buffer);
+                return NULL;
+            }
+
+            CHJSON *result = new CHJSON(json, true);
+            result->mBacking = new CBackingStore;
+            result->mBacking->buffer = buffer;
+            result->mBacking->tape = NULL;
+            result->mBacking->next = NULL;
+            return result;
+        }
+
+        CHJSON *CHJSON::parseLazy(char *buffer)
+        {
+            cJSON_Context context;
+            memset(&context, 0, sizeof(context));
+            cJSON_Tape *tape = cJSON_TapeParse(buffer, &context);
+            if (!tape) {
+                free(buffer);
+                return NULL;
+            }
+
+            CHJSON *result = new CHJSON(NULL, true);
+            result->mTape = tape;
+            result->mTapeIndex = 0;
+            result->mBacking = new CBackingStore;
+            result->mBacking->buffer = buffer;
+            result->mBacking->tape = tape;
+            result->mBacking->next = NULL;
+            return result;
+        }
         
         cstring CHJSON::print() const
         {
-            return cstring(cJSON_PrintUnformatted(mJSON), true);
+            cstring result;
+            printInto(result, 0);
+            return result;
         }
 
-        cstring& CHJSON::print(cstring &dest) const
+        // Tree to print this node from. For a lazy node, a temporary one is built (pointing to the same strings), with the
+        // keys kept aside lent at its end; give it back with returnTree.
+        cJSON *CHJSON::borrowTree(cJSON *&last) const
         {
-            dest <<= cJSON_PrintUnformatted(mJSON);
+            last = NULL;
+            if (mTapeIndex < 0) { return mJSON; }
+
+            cJSON *json = cJSON_TapeToTree(mTape, mTapeIndex);
+            if (json && mJSON) {
+                // Only linked forward: the keys stay in mJSON, whose list is left as it was
+                last = json->child ? json->child->prev : NULL;
+                if (last) { last->next = mJSON->child; } else { json->child = mJSON->child; }
+            }
+            return json;
+        }
+
+        void CHJSON::returnTree(cJSON *json, cJSON *last) const
+        {
+            if (json == mJSON) { return; }
+            // Take the keys back before deleting the temporary tree
+            if (last) { last->next = NULL; } else if (json && mJSON) { json->child = NULL; }
+            cJSON_Delete(json);
+        }
+
+        // Prints into the storage already held by dest (grown as needed) rather than allocating a new string.
+        cstring& CHJSON::printInto(cstring &dest, int fmt) const
+        {
+            cJSON *last, *json = borrowTree(last);
+            size_t capacity = dest ? strlen(dest) + 1 : 0;
+            char *buffer = dest.DetachOwnership();
+            if (!json || !cJSON_PrintIntoBuffer(json, &buffer, &capacity, fmt)) {
+                free(buffer);
+                buffer = NULL;
+            }
+            dest <<= buffer;
+            returnTree(json, last);
             return dest;
         }
 
+        cstring& CHJSON::print(cstring &dest) const
+        {
+            return printInto(dest, 0);
+        }
+
         cstring CHJSON::printFormatted() const
         {
-            return cstring(cJSON_Print(mJSON), true);
+            cstring result;
+            printInto(result, 1);
+            return result;
         }
 
         cstring& CHJSON::printFormatted(cstring& dest) const {
-            dest <<= cJSON_Print(mJSON);
-            return dest;
+            return printInto(dest, 1);
+        }
+
+        void *CHJSON::printBinary(size_t &size) const
+        {
+            cJSON *last, *json = borrowTree(last);
+            void *result = json ? cJSON_PrintBinary(json, &size) : NULL;
+            returnTree(json, last);
+            return result;
+        }
+
+        CHJSON *CHJSON::parseBinary(const void *data, size_t size)
+        {
+            // Only accept what starts like printBinary output, so that text can't be mistaken for it
+            const unsigned char *bytes = (const unsigned char*) data;
+            if (!data || size < 3 || bytes[0] != 0xD9 || bytes[1] != 0xD9 || bytes[2] != 0xF7) { return NULL; }
+
+            cJSON_Context context;
+            memset(&context, 0, sizeof(context));
+            cJSON *json = cJSON_ParseBinary(data, size, &context);
+            return json ? new CHJSON(json, true) : NULL;
         }
 
         void CHJSON::AddStringSafe(const char *item, const char *value)
@@ -274,6 +551,7 @@ namespace XtraLife {
 
         void CHJSON::AddOrReplaceStringSafe(const char *item, const char *value)
         {
+            makeWritable(item);
             cJSON *cj = cJSON_GetObjectItem(mJSON, item);
             if(cj == NULL)
             {
@@ -288,8 +566,9 @@ namespace XtraLife {
         
         void CHJSON::Delete(const char *item)
         {
+            makeWritable(item);
             cJSON *j = cJSON_DetachItemFromObject(mJSON,item);
-            if (j) delete j;
+            if (j) cJSON_Delete(j);
         }
 
         CHJSON* CHJSON::initWith(const char **args)
@@ -314,22 +593,28 @@ namespace XtraLife {
             this->garbage();
             if (release) {
                 cJSON_Delete(mJSON);
+                releaseBackingStore();
             }
             mNext = NULL;
             release = true;
+            mTape = NULL;
+            mTapeIndex = -1;
             mJSON = cJSON_CreateObject();
         }
 
         bool CHJSON::Has(const char *key) const {
-            return cJSON_GetObjectItem(mJSON, key) != NULL;
+            cJSON scratch;
+            return lookup(key, scratch) != NULL;
         }
 
         const char *CHJSON::GetString(const char *key, const char *defaultValue) const {
-            cJSON *cj = cJSON_GetObjectItem(mJSON, key);
+            cJSON scratch;
+            const cJSON *cj = lookup(key, scratch);
             return (cj && cj->valuestring) ? cj->valuestring : defaultValue;
         }
 
         void CHJSON::Put(const char *key, bool value) {
+            makeWritable(key);
             cJSON *cj = cJSON_GetObjectItem(mJSON, key);
             if (!cj) {
                 Add(key, value);
@@ -342,7 +627,18 @@ namespace XtraLife {
             Put(key, (double) value);
         }
 
+        void CHJSON::Put(const char *key, long long value) {
+            makeWritable(key);
+            CHJSON *json = new CHJSON(cJSON_CreateInt64(value), true);
+            if (!cJSON_GetObjectItem(mJSON, key)) {
+                Add(key, json);
+            } else {
+                Replace(key, json);
+            }
+        }
+
         void CHJSON::Put(const char *key, double value) {
+            makeWritable(key);
             cJSON *cj = cJSON_GetObjectItem(mJSON, key);
             if (!cj) {
                 Add(key, value);
@@ -359,7 +655,25 @@ namespace XtraLife {
             }
         }
 
+        void CHJSON::Put(const char *key, CHJSON &&json) {
+            Put(key, new CHJSON(std::move(json)));
+        }
+
+        void CHJSON::Add(CHJSON &&json) {
+            Add(new CHJSON(std::move(json)));
+        }
+
+        void CHJSON::Concat(CHJSON *json)
+        {
+            makeWritable();
+            json->makeWritable();
+            adopt(json);
+            cJSON_AddItemsToArray(mJSON, json->mJSON);
+            delete json;
+        }
+
         void CHJSON::Put(const char *key, CHJSON *json) {
+            makeWritable(key);
             cJSON *cj = cJSON_GetObjectItem(mJSON, key);
             if (cj) {
                 Delete(key);
@@ -402,5 +716,422 @@ namespace XtraLife {
         CHJSON::Iterator::Iterator(const CHJSON *json, int index) : json(json), index(index) {
 
         }
+
+        const CHJSON *CHJSON::At(const char *pointer) const {
+            CJsonPath path(pointer);
+            return path.Get(this);
+        }
+
+        // Walks the steps of path from this node, without allocating. Ends on a node of our tree, or of our tape if
+        // tapeIndex >= 0.
+        bool CHJSON::resolve(const CJsonPath &path, cJSON *&node, int &tapeIndex) const
+        {
+            node = mJSON;
+            tapeIndex = mTapeIndex;
+            if (!path.mValid) { return false; }
+
+            for (int i = 0; i < path.mCount; i++) {
+                const CJsonPath::Step &step = path.mSteps[i];
+                if (tapeIndex >= 0) {
+                    int type = cJSON_TapeType(mTape, tapeIndex), found = -1;
+                    if (type == cJSON_Object) {
+                        found = cJSON_TapeObjectItem(mTape, tapeIndex, step.key);
+                    } else if (type == cJSON_Array && step.index >= 0) {
+                        found = cJSON_TapeArrayItem(mTape, tapeIndex, step.index);
+                    }
+                    if (found >= 0) {
+                        tapeIndex = found;
+                        continue;
+                    }
+                    // Not in the tape: only a lazy root may still have it, among the keys kept aside
+                    tapeIndex = -1;
+                    if (i > 0) { return false; }
+                }
+
+                if (!node) { return false; }
+                int type = node->type & 255;
+                if (type == cJSON_Object) {
+                    node = cJSON_GetObjectItem(node, step.key);
+                } else if (type == cJSON_Array && step.index >= 0) {
+                    node = cJSON_GetArrayItem(node, step.index);
+                } else {
+                    node = NULL;
+                }
+                if (!node) { return false; }
+            }
+            return true;
+        }
+
+        CJsonPath::CJsonPath(const char *pointer) : mSteps(NULL), mCount(0), mKeys(NULL), mValid(false) {
+            // Every reference token starts with a '/'
+            if (!pointer || (*pointer && *pointer != '/')) { return; }
+            for (const char *p = pointer; *p; p++) {
+                if (*p == '/') { mCount++; }
+            }
+            if (mCount == 0) { mValid = true; return; }
+
+            // Tokens only ever shrink when unescaped
+            mKeys = (char*) malloc(strlen(pointer) + 1);
+            mSteps = (Step*) malloc(mCount * sizeof(Step));
+            char *out = mKeys;
+            const char *p = pointer;
+            for (int i = 0; i < mCount; i++) {
+                Step &step = mSteps[i];
+                step.key = out;
+                for (p++; *p && *p != '/'; p++) {
+                    if (*p != '~') { *out++ = *p; continue; }
+                    if (p[1] == '0') { *out++ = '~'; }
+                    else if (p[1] == '1') { *out++ = '/'; }
+                    else { return; }
+                    p++;
+                }
+                *out++ = 0;
+
+                // Array index: "0" or digits without leading zero, "-" (past the end) designates nothing
+                const char *digit = step.key;
+                long long index = 0;
+                while (*digit >= '0' && *digit <= '9' && index <= INT_MAX) { index = index * 10 + (*digit++ - '0'); }
+                bool isIndex = digit != step.key && !*digit && (step.key[0] != '0' || !step.key[1]) && index <= INT_MAX;
+                step.index = isIndex ? (int) index : -1;
+            }
+            mValid = true;
+        }
+
+        CJsonPath::~CJsonPath() {
+            free(mSteps);
+            free(mKeys);
+        }
+
+        // Value designated in json, decoded into scratch for a lazy node; NULL if there is none
+        const cJSON *CJsonPath::value(const CHJSON *json, cJSON &scratch) const {
+            cJSON *node;
+            int tapeIndex;
+            if (!json || !json->resolve(*this, node, tapeIndex)) { return NULL; }
+            if (tapeIndex < 0) { return node; }
+            cJSON_TapeValue(json->mTape, tapeIndex, &scratch);
+            return &scratch;
+        }
+
+        const CHJSON *CJsonPath::Get(const CHJSON *json) const {
+            cJSON *node;
+            int tapeIndex;
+            if (!json || !json->resolve(*this, node, tapeIndex)) { return NULL; }
+            return mCount == 0 ? json : json->wrap(node, tapeIndex);
+        }
+
+        bool CJsonPath::Has(const CHJSON *json) const {
+            cJSON scratch;
+            return value(json, scratch) != NULL;
+        }
+
+        const char *CJsonPath::GetString(const CHJSON *json, const char *defaultValue) const {
+            cJSON scratch;
+            const cJSON *cj = value(json, scratch);
+            return (cj && cj->valuestring) ? cj->valuestring : defaultValue;
+        }
+
+        int CJsonPath::GetInt(const CHJSON *json, int defaultValue) const {
+            cJSON scratch;
+            const cJSON *cj = value(json, scratch);
+            return (cj && (cj->type & 255) == CHJSON::jsonNumber) ? cj->valueint : defaultValue;
+        }
+
+        long long CJsonPath::GetInt64(const CHJSON *json, long long defaultValue) const {
+            cJSON scratch;
+            const cJSON *cj = value(json, scratch);
+            return (cj && (cj->type & 255) == CHJSON::jsonNumber) ? cj->valueint64 : defaultValue;
+        }
+
+        double CJsonPath::GetDouble(const CHJSON *json, double defaultValue) const {
+            cJSON scratch;
+            const cJSON *cj = value(json, scratch);
+            return (cj && (cj->type & 255) == CHJSON::jsonNumber) ? cj->valuedouble : defaultValue;
+        }
+
+        bool CJsonPath::GetBool(const CHJSON *json, bool defaultValue) const {
+            cJSON scratch;
+            const cJSON *cj = value(json, scratch);
+            return cj ? (cj->type & 255) == CHJSON::jsonTrue : defaultValue;
+        }
+
+        // Gives item the value of another node, which is deleted: item keeps its place in the tree and its name
+        static void assign(cJSON *item, cJSON *value)
+        {
+            if (!value) { return; }
+            cJSON old = *item;
+            item->type = (value->type & ~cJSON_StringIsConst) | (old.type & cJSON_StringIsConst);
+            item->child = value->child;
+            item->valuestring = value->valuestring;
+            item->valueint = value->valueint;
+            item->valuedouble = value->valuedouble;
+            item->valueint64 = value->valueint64;
+            // The former contents go away with value
+            value->type = (old.type & ~cJSON_StringIsConst) | (value->type & cJSON_StringIsConst);
+            value->child = old.child;
+            value->valuestring = old.valuestring;
+            cJSON_Delete(value);
+        }
+
+        // RFC 7396 merge patch turning from into to
+        static cJSON *mergeDiff(cJSON *from, cJSON *to)
+        {
+            if ((from->type & 255) != cJSON_Object || (to->type & 255) != cJSON_Object) {
+                return cJSON_Duplicate(to, 1);
+            }
+            cJSON *patch = cJSON_CreateObject();
+            for (cJSON *f = from->child; f; f = f->next) {
+                if (!cJSON_GetObjectItem(to, f->string)) { cJSON_AddItemToObject(patch, f->string, cJSON_CreateNull()); }
+            }
+            for (cJSON *t = to->child; t; t = t->next) {
+                cJSON *f = cJSON_GetObjectItem(from, t->string);
+                if (!f || !cJSON_Compare(f, t)) { cJSON_AddItemToObject(patch, t->string, f ? mergeDiff(f, t) : cJSON_Duplicate(t, 1)); }
+            }
+            return patch;
+        }
+
+        static void mergePatch(cJSON *target, cJSON *patch)
+        {
+            if ((patch->type & 255) != cJSON_Object) {
+                assign(target, cJSON_Duplicate(patch, 1));
+                return;
+            }
+            if ((target->type & 255) != cJSON_Object) { assign(target, cJSON_CreateObject()); }
+            for (cJSON *p = patch->child; p; p = p->next) {
+                if ((p->type & 255) == cJSON_NULL) {
+                    cJSON_DeleteItemFromObject(target, p->string);
+                    continue;
+                }
+                cJSON *t = cJSON_GetObjectItem(target, p->string);
+                if (!t) {
+                    t = cJSON_CreateNull();
+                    cJSON_AddItemToObject(target, p->string, t);
+                }
+                mergePatch(t, p);
+            }
+        }
+
+        // Path of a member of the node at path, with '~' and '/' escaped in its name
+        static void childPath(cstring &dest, const char *path, const char *token)
+        {
+            size_t parentLength = strlen(path), length = parentLength + 2;
+            for (const char *c = token; *c; c++) { length += (*c == '~' || *c == '/') ? 2 : 1; }
+            char *buffer = (char*) malloc(length), *out = buffer + parentLength;
+            memcpy(buffer, path, parentLength);
+            *out++ = '/';
+            for (; *token; token++) {
+                if (*token == '~' || *token == '/') {
+                    *out++ = '~';
+                    *out++ = *token == '~' ? '0' : '1';
+                } else {
+                    *out++ = *token;
+                }
+            }
+            *out = 0;
+            dest <<= buffer;
+        }
+
+        static void addOperation(cJSON *patch, const char *op, const char *path, cJSON *value)
+        {
+            cJSON *operation = cJSON_CreateObject();
+            cJSON_AddItemToObject(operation, "op", cJSON_CreateString(op));
+            cJSON_AddItemToObject(operation, "path", cJSON_CreateString(path));
+            if (value) { cJSON_AddItemToObject(operation, "value", cJSON_Duplicate(value, 1)); }
+            cJSON_AddItemToArray(patch, operation);
+        }
+
+        // RFC 6902 operations turning from (at path) into to, appended to patch
+        static void jsonDiff(cJSON *patch, const char *path, cJSON *from, cJSON *to)
+        {
+            if (cJSON_Compare(from, to)) { return; }
+            int type = from->type & 255;
+            if (type != (to->type & 255) || (type != cJSON_Object && type != cJSON_Array)) {
+                addOperation(patch, "replace", path, to);
+                return;
+            }
+
+            cstring child;
+            if (type == cJSON_Object) {
+                for (cJSON *f = from->child; f; f = f->next) {
+                    if (cJSON_GetObjectItem(to, f->string)) { continue; }
+                    childPath(child, path, f->string);
+                    addOperation(patch, "remove", child, NULL);
+                }
+                for (cJSON *t = to->child; t; t = t->next) {
+                    cJSON *f = cJSON_GetObjectItem(from, t->string);
+                    childPath(child, path, t->string);
+                    if (f) { jsonDiff(patch, child, f, t); }
+                    else { addOperation(patch, "add", child, t); }
+                }
+                return;
+            }
+
+            char index[16];
+            int i = 0;
+            cJSON *f = from->child, *t = to->child;
+            for (; f && t; f = f->next, t = t->next, i++) {
+                snprintf(index, sizeof(index), "%d", i);
+                childPath(child, path, index);
+                jsonDiff(patch, child, f, t);
+            }
+            // Extra items are removed from the last one, so that the indices of the others stay valid
+            for (int j = cJSON_GetArraySize(from) - 1; j >= i; j--) {
+                snprintf(index, sizeof(index), "%d", j);
+                childPath(child, path, index);
+                addOperation(patch, "remove", child, NULL);
+            }
+            for (; t; t = t->next, i++) {
+                snprintf(index, sizeof(index), "%d", i);
+                childPath(child, path, index);
+                addOperation(patch, "add", child, t);
+            }
+        }
+
+        CHJSON *CHJSON::Diff(const CHJSON *from, const CHJSON *to, patchFormat format)
+        {
+            cJSON *fromLast, *fromTree = from->borrowTree(fromLast);
+            cJSON *toLast, *toTree = to->borrowTree(toLast);
+            cJSON *patch;
+            if (format == patchJson) {
+                patch = cJSON_CreateArray();
+                jsonDiff(patch, "", fromTree, toTree);
+            } else {
+                patch = mergeDiff(fromTree, toTree);
+            }
+            to->returnTree(toTree, toLast);
+            from->returnTree(fromTree, fromLast);
+            return new CHJSON(patch, true);
+        }
+
+        bool CHJSON::ApplyPatch(const CHJSON *patch, patchFormat format)
+        {
+            if (!patch) { return false; }
+            makeWritable();
+            cJSON *last, *tree = patch->borrowTree(last);
+            bool result = true;
+            if (format == patchMerge) {
+                mergePatch(mJSON, tree);
+            } else if ((tree->type & 255) != cJSON_Array) {
+                result = false;
+            } else {
+                cJSON *op = tree->child ? cJSON_GetObjectItem(tree->child, "op") : NULL;
+                // A single operation checks everything before modifying anything, except a move. Otherwise work on a copy,
+                // so that a failure leaves us untouched.
+                if (op && !tree->child->next && !(op->valuestring && !strcmp(op->valuestring, "move"))) {
+                    result = applyOperation(mJSON, tree->child);
+                } else {
+                    cJSON *copy = cJSON_Duplicate(mJSON, 1);
+                    for (cJSON *operation = tree->child; operation && result; operation = operation->next) {
+                        result = applyOperation(copy, operation);
+                    }
+                    if (result) { assign(mJSON, copy); }
+                    else { cJSON_Delete(copy); }
+                }
+            }
+            patch->returnTree(tree, last);
+            return result;
+        }
+
+        // Node reached in a tree by the first steps of path, NULL if there is none
+        cJSON *CHJSON::locate(cJSON *root, const CJsonPath &path, int steps)
+        {
+            cJSON *node = path.mValid ? root : NULL;
+            for (int i = 0; i < steps && node; i++) {
+                const CJsonPath::Step &step = path.mSteps[i];
+                int type = node->type & 255;
+                if (type == cJSON_Object) {
+                    node = cJSON_GetObjectItem(node, step.key);
+                } else if (type == cJSON_Array && step.index >= 0) {
+                    node = cJSON_GetArrayItem(node, step.index);
+                } else {
+                    node = NULL;
+                }
+            }
+            return node;
+        }
+
+        // Takes the node designated by path (other than the root) out of the tree
+        cJSON *CHJSON::detach(cJSON *root, const CJsonPath &path)
+        {
+            cJSON *parent = path.mCount > 0 ? locate(root, path, path.mCount - 1) : NULL;
+            if (!parent) { return NULL; }
+            const CJsonPath::Step &last = path.mSteps[path.mCount - 1];
+            if ((parent->type & 255) == cJSON_Object) { return cJSON_DetachItemFromObject(parent, last.key); }
+            if ((parent->type & 255) == cJSON_Array && last.index >= 0) { return cJSON_DetachItemFromArray(parent, last.index); }
+            return NULL;
+        }
+
+        // Puts value at path as the "add" operation does: setting an object member, or inserting into an array ("-" to
+        // append). value is taken ownership of, even in case of failure.
+        bool CHJSON::insert(cJSON *root, const CJsonPath &path, cJSON *value)
+        {
+            if (!value || !path.mValid) {
+                cJSON_Delete(value);
+                return false;
+            }
+            if (path.mCount == 0) {
+                assign(root, value);
+                return true;
+            }
+
+            cJSON *parent = locate(root, path, path.mCount - 1);
+            const CJsonPath::Step &last = path.mSteps[path.mCount - 1];
+            int type = parent ? parent->type & 255 : cJSON_NULL;
+            if (type == cJSON_Object) {
+                if (cJSON_GetObjectItem(parent, last.key)) { cJSON_ReplaceItemInObject(parent, last.key, value); }
+                else { cJSON_AddItemToObject(parent, last.key, value); }
+                return true;
+            }
+            if (type == cJSON_Array && !strcmp(last.key, "-")) {
+                cJSON_AddItemToArray(parent, value);
+                return true;
+            }
+            if (type == cJSON_Array && last.index >= 0 && last.index <= cJSON_GetArraySize(parent)) {
+                cJSON_InsertItemInArray(parent, last.index, value);
+                return true;
+            }
+            cJSON_Delete(value);
+            return false;
+        }
+
+        // Applies an operation of a JSON Patch to a tree
+        bool CHJSON::applyOperation(cJSON *root, cJSON *operation)
+        {
+            cJSON *op = cJSON_GetObjectItem(operation, "op"), *target = cJSON_GetObjectItem(operation, "path");
+            cJSON *value = cJSON_GetObjectItem(operation, "value"), *from = cJSON_GetObjectItem(operation, "from");
+            if (!op || !op->valuestring || !target || !target->valuestring) { return false; }
+            const char *name = op->valuestring;
+            CJsonPath path(target->valuestring);
+            if (!path.mValid) { return false; }
+
+            if (!strcmp(name, "add")) {
+                return value && insert(root, path, cJSON_Duplicate(value, 1));
+            } else if (!strcmp(name, "remove")) {
+                cJSON *removed = detach(root, path);
+                cJSON_Delete(removed);
+                return removed != NULL;
+            } else if (!strcmp(name, "replace")) {
+                cJSON *node = locate(root, path, path.mCount);
+                if (!node || !value) { return false; }
+                assign(node, cJSON_Duplicate(value, 1));
+                return true;
+            } else if (!strcmp(name, "test")) {
+                return value && cJSON_Compare(locate(root, path, path.mCount), value);
+            }
+
+            if (!from || !from->valuestring) { return false; }
+            CJsonPath source(from->valuestring);
+            if (!strcmp(name, "copy")) {
+                cJSON *node = locate(root, source, source.mCount);
+                return node && insert(root, path, cJSON_Duplicate(node, 1));
+            } else if (!strcmp(name, "move")) {
+                if (!strcmp(from->valuestring, target->valuestring)) { return locate(root, source, source.mCount) != NULL; }
+                // A value can't be moved into itself
+                size_t length = strlen(from->valuestring);
+                if (!strncmp(target->valuestring, from->valuestring, length) && target->valuestring[length] == '/') { return false; }
+                cJSON *node = detach(root, source);
+                return node && insert(root, path, node);
+            }
+            return false;
+        }
     }
 }
@@ -0,0 +1,331 @@
+//
+//  CJsonReader.cpp
+//  XtraLife
+//
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "include/CJsonReader.h"
+#include "ExternalModules/cJSON/cJSON.h"
+
+namespace XtraLife {
+    namespace Helpers {
+
+        // What the reader expects next
+        enum {
+            stValue,            // a value (top level, after ':' or after ',' in an array)
+            stValueOrEnd,       // right after '['
+            stKey,              // after ',' in an object
+            stKeyOrEnd,         // right after '{'
+            stColon,            // after a key
+            stCommaOrEnd,       // after a value inside a container
+            stDone              // after the top level value
+        };
+
+        static bool isNumberChar(char c) {
+            return (c >= '0' && c <= '9') || c == '-' || c == '+' || c == '.' || c == 'e' || c == 'E';
+        }
+
+        static int hexValue(char c) {
+            if (c >= '0' && c <= '9') return c - '0';
+            if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+            if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+            return -1;
+        }
+
+        static bool parseHex4(const char *from, const char *to, unsigned &result) {
+            if (to - from < 4) { return false; }
+            result = 0;
+            for (int i = 0; i < 4; i++) {
+                int digit = hexValue(from[i]);
+                if (digit < 0) { return false; }
+                result = (result << 4) | digit;
+            }
+            return true;
+        }
+
+        static char *encodeUtf8(char *out, unsigned uc) {
+            if (uc < 0x80) {
+                *out++ = (char) uc;
+            } else if (uc < 0x800) {
+                *out++ = (char) (0xC0 | (uc >> 6));
+                *out++ = (char) (0x80 | (uc & 0x3F));
+            } else if (uc < 0x10000) {
+                *out++ = (char) (0xE0 | (uc >> 12));
+                *out++ = (char) (0x80 | ((uc >> 6) & 0x3F));
+                *out++ = (char) (0x80 | (uc & 0x3F));
+            } else {
+                *out++ = (char) (0xF0 | (uc >> 18));
+                *out++ = (char) (0x80 | ((uc >> 12) & 0x3F));
+                *out++ = (char) (0x80 | ((uc >> 6) & 0x3F));
+                *out++ = (char) (0x80 | (uc & 0x3F));
+            }
+            return out;
+        }
+
+        CJsonReader::CJsonReader(int maxDepth)
+            : mBuffer(NULL), mCapacity(0), mValue(NULL), mValueCapacity(0), mStack(NULL), mMaxDepth(maxDepth > 0 ? maxDepth : CJSON_NESTING_LIMIT), mStackCapacity(0) {
+            Reset();
+        }
+
+        CJsonReader::~CJsonReader() {
+            free(mBuffer);
+            free(mValue);
+            free(mStack);
+        }
+
+        void CJsonReader::Reset() {
+            mStart = mEnd = mDiscarded = mScanResume = 0;
+            mValueLength = 0;
+            if (mValue) { mValue[0] = 0; }
+            mDouble = 0;
+            mInt64 = 0;
+            mDepth = 0;
+            mState = stValue;
+            mSkipDepth = 0;
+            mLast = tokNeedMore;
+            mFinished = mSkipping = false;
+            mErrorOffset = 0;
+        }
+
+        void CJsonReader::Feed(const char *data, size_t length) {
+            if (mLast == tokError || length == 0) { return; }
+
+            // Drop what has been consumed: the buffer only ever holds the token in progress plus the new data
+            if (mStart > 0) {
+                memmove(mBuffer, mBuffer + mStart, mEnd - mStart);
+                mDiscarded += mStart;
+                mEnd -= mStart;
+                mStart = 0;
+            }
+            if (mEnd + length + 1 > mCapacity) {
+                size_t capacity = mCapacity * 2 > mEnd + length + 1 ? mCapacity * 2 : mEnd + length + 4096;
+                char *buffer = (char*) realloc(mBuffer, capacity);
+                if (!buffer) { Fail(); return; }
+                mBuffer = buffer;
+                mCapacity = capacity;
+            }
+            memcpy(mBuffer + mEnd, data, length);
+            mEnd += length;
+            mBuffer[mEnd] = 0;
+        }
+
+        void CJsonReader::Finish() {
+            mFinished = true;
+        }
+
+        CJsonReader::Token CJsonReader::Next() {
+            for (;;) {
+                Token token = Lex();
+                if (!mSkipping || token == tokNeedMore || token == tokError) {
+                    if (token != tokNeedMore) { mLast = token; }
+                    return token;
+                }
+                // Swallow the tokens of the value being skipped, up to the one which brings us back to the original level
+                if (mDepth <= mSkipDepth) { mSkipping = false; }
+            }
+        }
+
+        void CJsonReader::SkipValue() {
+            if (mLast == tokStartObject || mLast == tokStartArray) {
+                mSkipping = true;
+                mSkipDepth = mDepth - 1;
+            } else if (mLast == tokKey) {
+                mSkipping = true;
+                mSkipDepth = mDepth;
+            }
+        }
+
+        CJsonReader::Token CJsonReader::Lex() {
+            if (mLast == tokError) { return tokError; }
+            for (;;) {
+                while (mStart < mEnd && (unsigned char) mBuffer[mStart] <= 32) { mStart++; }
+                if (mState == stDone) { return tokEnd; }
+                if (mStart == mEnd) { return mFinished ? Fail() : tokNeedMore; }
+
+                char c = mBuffer[mStart];
+                switch (mState) {
+                    case stColon:
+                        if (c != ':') { return Fail(); }
+                        mStart++;
+                        mState = stValue;
+                        continue;
+                    case stCommaOrEnd:
+                        if (c != ',') { return CloseContainer(c); }
+                        mStart++;
+                        mState = mStack[mDepth - 1] == '{' ? stKey : stValue;
+                        continue;
+                    case stKeyOrEnd:
+                        if (c == '}') { return CloseContainer(c); }
+                        // Fall through
+                    case stKey: {
+                        if (c != '"') { return Fail(); }
+                        Token token = LexString(tokKey);
+                        if (token == tokKey) { mState = stColon; }
+                        return token;
+                    }
+                    case stValueOrEnd:
+                        if (c == ']') { return CloseContainer(c); }
+                        // Fall through
+                    default:
+                        return LexValue(c);
+                }
+            }
+        }
+
+        CJsonReader::Token CJsonReader::LexValue(char c) {
+            switch (c) {
+                case '{':
+                case '[':
+                    if (mDepth >= mMaxDepth) { return Fail(); }
+                    if (mDepth == mStackCapacity) {
+                        int capacity = mStackCapacity ? mStackCapacity * 2 : 32;
+                        char *stack = (char*) realloc(mStack, capacity);
+                        if (!stack) { return Fail(); }
+                        mStack = stack;
+                        mStackCapacity = capacity;
+                    }
+                    mStack[mDepth++] = c;
+                    mStart++;
+                    mState = c == '{' ? stKeyOrEnd : stValueOrEnd;
+                    return c == '{' ? tokStartObject : tokStartArray;
+                case '"': return Scalar(LexString(tokString));
+                case 't': return Scalar(LexLiteral("true", tokTrue));
+                case 'f': return Scalar(LexLiteral("false", tokFalse));
+                case 'n': return Scalar(LexLiteral("null", tokNull));
+                default:
+                    if (c == '-' || (c >= '0' && c <= '9')) { return Scalar(LexNumber()); }
+                    return Fail();
+            }
+        }
+
+        CJsonReader::Token CJsonReader::Scalar(Token token) {
+            if (token != tokNeedMore && token != tokError) {
+                mState = mDepth > 0 ? stCommaOrEnd : stDone;
+            }
+            return token;
+        }
+
+        CJsonReader::Token CJsonReader::CloseContainer(char c) {
+            char open = mStack[mDepth - 1];
+            if ((open == '{' && c != '}') || (open == '[' && c != ']')) { return Fail(); }
+            mStart++;
+            mDepth--;
+            mState = mDepth > 0 ? stCommaOrEnd : stDone;
+            return open == '{' ? tokEndObject : tokEndArray;
+        }
+
+        CJsonReader::Token CJsonReader::LexString(Token token) {
+            // Look for the closing quote, resuming where the last attempt stopped if the string spans several Feed()s
+            size_t pos = mStart + 1 + mScanResume;
+            while (pos < mEnd && mBuffer[pos] != '"') {
+                if (mBuffer[pos] == '\\') {
+                    if (pos + 1 >= mEnd) { break; }     // the escaped character is yet to come
+                    pos++;
+                }
+                pos++;
+            }
+            if (pos >= mEnd || mBuffer[pos] != '"') {
+                if (mFinished) { return Fail(); }
+                mScanResume = pos - mStart - 1;
+                return tokNeedMore;
+            }
+
+            mScanResume = 0;
+            if (mSkipping) {
+                mValueLength = 0;
+            } else if (!Unescape(mBuffer + mStart + 1, mBuffer + pos)) {
+                return Fail();
+            }
+            mStart = pos + 1;
+            return token;
+        }
+
+        CJsonReader::Token CJsonReader::LexNumber() {
+            size_t end = mStart;
+            while (end < mEnd && isNumberChar(mBuffer[end])) { end++; }
+            // The number may go on in the next piece
+            if (end == mEnd && !mFinished) { return tokNeedMore; }
+
+            size_t length = end - mStart;
+            if (!ReserveValue(length + 1)) { return Fail(); }
+            memcpy(mValue, mBuffer + mStart, length);
+            mValue[length] = 0;
+            mValueLength = length;
+
+            cJSON number;
+            memset(&number, 0, sizeof(number));
+            if (cJSON_ParseNumber(&number, mValue) != mValue + length) { return Fail(); }
+            mDouble = number.valuedouble;
+            mInt64 = number.valueint64;
+            mStart = end;
+            return tokNumber;
+        }
+
+        CJsonReader::Token CJsonReader::LexLiteral(const char *literal, Token token) {
+            size_t length = strlen(literal);
+            if (mEnd - mStart < length) { return mFinished ? Fail() : tokNeedMore; }
+            if (memcmp(mBuffer + mStart, literal, length)) { return Fail(); }
+            mStart += length;
+            return token;
+        }
+
+        CJsonReader::Token CJsonReader::Fail() {
+            mErrorOffset = mDiscarded + mStart;
+            mSkipping = false;
+            mScanResume = 0;
+            return mLast = tokError;
+        }
+
+        bool CJsonReader::ReserveValue(size_t size) {
+            if (size <= mValueCapacity) { return true; }
+            size_t capacity = size > 2 * mValueCapacity ? size + 64 : 2 * mValueCapacity;
+            char *value = (char*) realloc(mValue, capacity);
+            if (!value) { return false; }
+            mValue = value;
+            mValueCapacity = capacity;
+            return true;
+        }
+
+        bool CJsonReader::Unescape(const char *from, const char *to) {
+            // The decoded string is never longer than its escaped form
+            if (!ReserveValue(to - from + 1)) { return false; }
+            char *out = mValue;
+            while (from < to) {
+                const char *backslash = (const char*) memchr(from, '\\', to - from);
+                const char *runEnd = backslash ? backslash : to;
+                memcpy(out, from, runEnd - from);
+                out += runEnd - from;
+                from = runEnd;
+                if (from == to) { break; }
+
+                from++;
+                switch (*from++) {
+                    case 'b': *out++ = '\b'; break;
+                    case 'f': *out++ = '\f'; break;
+                    case 'n': *out++ = '\n'; break;
+                    case 'r': *out++ = '\r'; break;
+                    case 't': *out++ = '\t'; break;
+                    case 'u': {
+                        unsigned uc, low;
+                        if (!parseHex4(from, to, uc)) { return false; }
+                        from += 4;
+                        // Combine UTF-16 surrogate pairs
+                        if (uc >= 0xD800 && uc <= 0xDBFF && to - from >= 6 && from[0] == '\\' && from[1] == 'u'
+                            && parseHex4(from + 2, to, low) && low >= 0xDC00 && low <= 0xDFFF) {
+                            uc = 0x10000 + ((uc - 0xD800) << 10) + (low - 0xDC00);
+                            from += 6;
+                        }
+                        out = encodeUtf8(out, uc);
+                        break;
+                    }
+                    default: *out++ = from[-1]; break;
+                }
+            }
+            *out = 0;
+            mValueLength = out - mValue;
+            return true;
+        }
+    }
+}
@@ -0,0 +1,111 @@
+//
+//  CJsonStruct.cpp
+//  XtraLife
+//
+
+#include <string.h>
+
+#include "include/CJsonStruct.h"
+#include "ExternalModules/cJSON/cJSON.h"
+
+namespace XtraLife {
+    namespace Helpers {
+
+        // Value being decoded: a node of a tree, or a value of a tape (lazily parsed JSON)
+        struct CJsonStructNode {
+            cJSON *json;
+            cJSON_Tape *tape;
+            int index;
+
+            const char *Name() const { return tape ? cJSON_TapeName(tape, index) : json->string; }
+            const cJSON *Value(cJSON &scratch) const {
+                if (!tape) { return json; }
+                cJSON_TapeValue(tape, index, &scratch);
+                return &scratch;
+            }
+            bool First(const CJsonStructNode &parent) {
+                json = NULL, tape = parent.tape;
+                if (tape) { return (index = cJSON_TapeChild(tape, parent.index)) >= 0; }
+                return (json = parent.json->child) != NULL;
+            }
+            bool Next(const CJsonStructNode &parent) {
+                if (tape) { return (index = cJSON_TapeNext(tape, parent.index, index)) >= 0; }
+                return (json = json->next) != NULL;
+            }
+        };
+
+        void CJsonStruct::decodeObject(const CJsonStructNode &object, const CJsonSchema &schema, void *dest) {
+            CJsonStructNode child;
+            int next = 0;
+            for (bool more = child.First(object); more; more = child.Next(object)) {
+                const char *name = child.Name();
+                if (!name) { continue; }
+                // Keys usually come in the same order as the fields are declared: look from the one following the last match
+                for (int i = 0; i < schema.count; i++) {
+                    const CJsonField &field = schema.fields[(next + i) % schema.count];
+                    if (field.name == name || !strcmp(field.name, name)) {
+                        decodeValue(child, field, field.member(dest));
+                        next = (next + i + 1) % schema.count;
+                        break;
+                    }
+                }
+            }
+        }
+
+        void CJsonStruct::decodeValue(const CJsonStructNode &node, const CJsonField &field, void *dest) {
+            cJSON scratch;
+            const cJSON *value = node.Value(scratch);
+            int type = value->type & 255;
+            switch (field.kind) {
+                case CJsonField::fieldString:
+                    if (type == cJSON_String) { *static_cast<cstring*>(dest) = value->valuestring; }
+                    break;
+                case CJsonField::fieldInt:
+                    if (type == cJSON_Number) { *static_cast<int*>(dest) = value->valueint; }
+                    break;
+                case CJsonField::fieldInt64:
+                    if (type == cJSON_Number) { *static_cast<long long*>(dest) = value->valueint64; }
+                    break;
+                case CJsonField::fieldDouble:
+                    if (type == cJSON_Number) { *static_cast<double*>(dest) = value->valuedouble; }
+                    break;
+                case CJsonField::fieldBool:
+                    if (type == cJSON_True || type == cJSON_False) { *static_cast<bool*>(dest) = type == cJSON_True; }
+                    break;
+                case CJsonField::fieldJson: {
+                    // Strings of a tape live in its buffer: the copy must own its own
+                    cJSON *tree = node.tape ? cJSON_TapeToTree(node.tape, node.index) : node.json;
+                    cJSON *copy = cJSON_Duplicate(tree, 1);
+                    if (tree != node.json) { cJSON_Delete(tree); }
+                    if (copy) { *static_cast<owned_ref<CHJSON>*>(dest) <<= new CHJSON(copy, true); }
+                    break;
+                }
+                case CJsonField::fieldObject:
+                    if (type == cJSON_Object) { decodeObject(node, field.schema(), dest); }
+                    break;
+                case CJsonField::fieldArray:
+                    if (type == cJSON_Array) {
+                        const CJsonField &element = field.element();
+                        CJsonStructNode item;
+                        field.clear(dest);
+                        for (bool more = item.First(node); more; more = item.Next(node)) {
+                            decodeValue(item, element, field.append(dest));
+                        }
+                    }
+                    break;
+            }
+        }
+
+        bool CJsonStruct::Decode(const CHJSON *json, const CJsonSchema &schema, void *dest) {
+            if (!json || json->type() != CHJSON::jsonObject) { return false; }
+            CJsonStructNode node = { json->mJSON, NULL, -1 };
+            if (json->mTapeIndex >= 0) {
+                CJsonStructNode lazy = { NULL, json->mTape, json->mTapeIndex };
+                decodeObject(lazy, schema, dest);
+            }
+            // For a lazy root, the keys added to it come next
+            if (node.json) { decodeObject(node, schema, dest); }
+            return true;
+        }
+    }
+}
@@ -1,9 +1,19 @@
 #include "CStdioBasedFileImpl.h"
 
+#ifdef _WINDOWS
+#include <windows.h>
+#include <io.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
 using namespace XtraLife;
 
 CInputFileStdio::CInputFileStdio(const char *fileName) {
 	underlyingFile = fopen(fileName, "rb");
+	mapping = NULL;
+	mappingSize = 0;
 }
 
 CInputFileStdio::~CInputFileStdio() {
@@ -11,6 +21,14 @@ CInputFileStdio::~CInputFileStdio() {
 }
 
 void CInputFileStdio::Close() {
+	if (mapping) {
+#ifdef _WINDOWS
+		UnmapViewOfFile(mapping);
+#else
+		munmap(mapping, mappingSize);
+#endif
+		mapping = NULL;
+	}
 	if (underlyingFile) {
 		fclose(underlyingFile);
 	}
@@ -39,6 +57,36 @@ bool CInputFileStdio::Seek(long offset, int whence) {
 	return !fseek(underlyingFile, offset, whence);
 }
 
+const void *CInputFileStdio::Map(size_t &size) {
+	if (!mapping && underlyingFile) {
+#ifdef _WINDOWS
+		HANDLE file = (HANDLE) _get_osfhandle(_fileno(underlyingFile));
+		LARGE_INTEGER fileSize;
+		if (file == INVALID_HANDLE_VALUE || !GetFileSizeEx(file, &fileSize) || fileSize.QuadPart == 0) {
+			return NULL;
+		}
+		// The view keeps the mapping alive by itself
+		HANDLE fileMapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+		if (!fileMapping) {
+			return NULL;
+		}
+		mapping = MapViewOfFile(fileMapping, FILE_MAP_READ, 0, 0, 0);
+		CloseHandle(fileMapping);
+		mappingSize = (size_t) fileSize.QuadPart;
+#else
+		struct stat info;
+		if (fstat(fileno(underlyingFile), &info) || info.st_size == 0) {
+			return NULL;
+		}
+		void *data = mmap(NULL, (size_t) info.st_size, PROT_READ, MAP_PRIVATE, fileno(underlyingFile), 0);
+		mapping = data == MAP_FAILED ? NULL : data;
+		mappingSize = (size_t) info.st_size;
+#endif
+	}
+	size = mappingSize;
+	return mapping;
+}
+
 COutputFileStdio::COutputFileStdio(const char *fileName) {
 	underlyingFile = fopen(fileName, "wb");
 }
@@ -21,12 +21,16 @@
 namespace XtraLife {
 	class CInputFileStdio: public CInputFile {
 		FILE *underlyingFile;
+		// Contents of the file mapped in memory by Map(), if it has been called
+		void *mapping;
+		size_t mappingSize;
 
 		virtual void Close();
 		virtual size_t Tell();
 		virtual bool IsOpen();
 		virtual size_t Read(void *destBuffer, size_t numBytes);
 		virtual bool Seek(long offset, int whence);
+		virtual const void *Map(size_t &size);
 
 	public:
 		CInputFileStdio(const char *fileName);
@@ -7,9 +7,12 @@
 //
 
 #include <pthread.h>
+#include <stdio.h>
+#include <thread>
 
 #include "XtraLife_thread.h"
 #include "include/XtraLifeHelpers.h"
+#include "Core/XtraLife_private.h"
 
 namespace XtraLife {
 namespace Helpers {
@@ -30,48 +33,57 @@ int gettimeofday (struct timeval *tp, void *tz) {
 }
 #else
 #include <sys/time.h>
+#include <time.h>
 #endif
 
-//////////////////////////// OS-specific vars for the classes //////////////////////////////////////////////
-struct CMutexVars {
-	pthread_mutex_t mutex;
-};
-struct CConditionVariableVars {
-	pthread_cond_t cond;
-};
-struct CThreadVars {
-	pthread_t runningThread;
-};
-
 //////////////////////////// Mutex //////////////////////////////////////////////
 CMutex::CMutex() {
-	mVars = new CMutexVars;
-	pthread_mutex_init(&mVars->mutex, NULL);
+	pthread_mutex_init(&mMutex, NULL);
 }
 
 CMutex::~CMutex() {
-	pthread_mutex_destroy(&mVars->mutex);
-	delete mVars;
+	pthread_mutex_destroy(&mMutex);
 }
 
 void CMutex::Lock() {
-	pthread_mutex_lock(&mVars->mutex);
+	pthread_mutex_lock(&mMutex);
 }
 
 void CMutex::Unlock() {
-	pthread_mutex_unlock(&mVars->mutex);
+	pthread_mutex_unlock(&mMutex);
+}
+
+//////////////////////////// Read-write lock //////////////////////////////////////////////
+CReadWriteLock::CReadWriteLock() {
+	pthread_rwlock_init(&mLock, NULL);
+}
+
+CReadWriteLock::~CReadWriteLock() {
+	pthread_rwlock_destroy(&mLock);
+}
+
+void CReadWriteLock::LockRead() {
+	pthread_rwlock_rdlock(&mLock);
+}
+
+void CReadWriteLock::LockWrite() {
+	pthread_rwlock_wrlock(&mLock);
+}
+
+void CReadWriteLock::Unlock() {
+	pthread_rwlock_unlock(&mLock);
 }
 
 //////////////////////////// Thread //////////////////////////////////////////////
 CThread::CThread() : mState(READY) {
-	mVars = new CThreadVars;
 }
 
 CThread::~CThread() {
-	if (mState != READY) {
-		pthread_detach(mVars->runningThread);
+	// A joined thread is gone already: detaching it again would be undefined
+	state current = mState;
+	if (current == RUNNING || current == COMPLETED) {
+		pthread_detach(mRunningThread);
 	}
-	delete mVars;
 }
 
 bool CThread::Start() {
@@ -81,21 +93,33 @@ bool CThread::Start() {
 	}
 
 	// Start the thread
-	int rc = pthread_create(&mVars->runningThread, NULL, startupRoutine, (void*) this);
-	if (rc == 0) {
-		mState = RUNNING;
-		this->Retain();
+	state ready = READY;
+	if (!mState.compare_exchange_strong(ready, RUNNING)) {
+		return false;
+	}
+	this->Retain();
+	int rc = pthread_create(&mRunningThread, NULL, startupRoutine, (void*) this);
+	if (rc != 0) {
+		mState = READY;
+		this->Release();
 	}
 	return rc == 0;
 }
 
 bool CThread::Join() {
-	if (mState != RUNNING) {
+	state current = mState;
+	if (current == READY) {
 		return false;
 	}
+	if (current == JOINED) {
+		return true;
+	}
 
 	void *unusedThExitCode;
-	int rc = pthread_join(mVars->runningThread, &unusedThExitCode);
+	int rc = pthread_join(mRunningThread, &unusedThExitCode);
+	if (rc == 0) {
+		mState = JOINED;
+	}
 	return rc == 0;
 }
 
@@ -112,14 +136,25 @@ void *CThread::startupRoutine(void *class_xlThread) {
 }
 
 //////////////////////////// Condition variable //////////////////////////////////////////////
-CConditionVariable::CConditionVariable() {
-	mVars = new CConditionVariableVars;
-	pthread_cond_init(&mVars->cond, NULL);
+// Apple platforms wait for a relative time instead, and Windows only offers the real time clock
+#if !defined(__APPLE__) && !defined(_WINDOWS)
+#	define MONOTONIC_CONDITION_VARIABLE
+#endif
+
+CConditionVariable::CConditionVariable() : mWaiters(0) {
+#ifdef MONOTONIC_CONDITION_VARIABLE
+	pthread_condattr_t attr;
+	pthread_condattr_init(&attr);
+	pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+	pthread_cond_init(&mCond, &attr);
+	pthread_condattr_destroy(&attr);
+#else
+	pthread_cond_init(&mCond, NULL);
+#endif
 }
 
 CConditionVariable::~CConditionVariable() {
-	pthread_cond_destroy(&mVars->cond);
-	delete mVars;
+	pthread_cond_destroy(&mCond);
 }
 
 void CConditionVariable::LockVar() {
@@ -131,25 +166,187 @@ void CConditionVariable::UnlockVar() {
 }
 
 void CConditionVariable::SignalAll() {
-	pthread_cond_broadcast(&mVars->cond);
+	if (mWaiters > 0) {
+		pthread_cond_broadcast(&mCond);
+	}
 }
 
 void CConditionVariable::SignalOne() {
-	pthread_cond_signal(&mVars->cond);
+	if (mWaiters > 0) {
+		pthread_cond_signal(&mCond);
+	}
 }
 
 bool CConditionVariable::Wait(int timeoutMilliseconds) {
+	int rc;
+	mWaiters++;
 	if (timeoutMilliseconds == 0) {
-		return pthread_cond_wait(&mVars->cond, &mMutex.mVars->mutex) == 0;
+		rc = pthread_cond_wait(&mCond, &mMutex.mMutex);
 	} else {
-		timeval tv;
+#ifdef __APPLE__
+		timespec ts = { timeoutMilliseconds / 1000, (timeoutMilliseconds % 1000) * 1000 * 1000 };
+		rc = pthread_cond_timedwait_relative_np(&mCond, &mMutex.mMutex, &ts);
+#else
 		timespec ts;
+#	ifdef MONOTONIC_CONDITION_VARIABLE
+		clock_gettime(CLOCK_MONOTONIC, &ts);
+#	else
+		timeval tv;
 		gettimeofday(&tv, NULL);
-		ts.tv_sec = time(NULL) + timeoutMilliseconds / 1000;
-		ts.tv_nsec = tv.tv_usec * 1000 + 1000 * 1000 * (timeoutMilliseconds % 1000);
+		ts.tv_sec = tv.tv_sec;
+		ts.tv_nsec = tv.tv_usec * 1000;
+#	endif
+		ts.tv_sec += timeoutMilliseconds / 1000;
+		ts.tv_nsec += 1000 * 1000 * (timeoutMilliseconds % 1000);
 		ts.tv_sec += ts.tv_nsec / (1000 * 1000 * 1000);
 		ts.tv_nsec %= (1000 * 1000 * 1000);
-		return pthread_cond_timedwait(&mVars->cond, &mMutex.mVars->mutex, &ts) == 0;
+		rc = pthread_cond_timedwait(&mCond, &mMutex.mMutex, &ts);
+#endif
+	}
+	mWaiters--;
+	return rc == 0;
+}
+
+//////////////////////////// Thread pool //////////////////////////////////////////////
+struct CThreadPool::Worker: CThread {
+	CThreadPool *pool;
+	int queueIndex;
+	Worker(CThreadPool *pool, int queueIndex) : pool(pool), queueIndex(queueIndex) {}
+	virtual void Run() { pool->Work(queueIndex); }
+};
+
+static CMutex g_threadPoolMutex;
+static CThreadPool *g_threadPool = NULL;
+static int g_threadPoolSize = 0;
+// Set while Terminate waits for the tasks left
+static bool g_threadPoolTerminating = false;
+
+void CThreadPool::Configure(int threadCount) {
+	CMutex::ScopedLock lock (g_threadPoolMutex);
+	if (g_threadPool) {
+		CONSOLE_WARNING("The thread pool is already running, its size will change after a Terminate\n");
+	}
+	g_threadPoolSize = threadCount;
+}
+
+void CThreadPool::Submit(CTask *task) {
+	CThreadPool *pool = NULL;
+	{
+		CMutex::ScopedLock lock (g_threadPoolMutex);
+		if (!g_threadPoolTerminating) {
+			if (!g_threadPool) {
+				int threadCount = g_threadPoolSize > 0 ? g_threadPoolSize : (int) std::thread::hardware_concurrency();
+				// The number of cores may be unknown
+				g_threadPool = new CThreadPool(threadCount > 0 ? threadCount : 2);
+			}
+			pool = g_threadPool;
+			pool->mSubmitting++;
+		}
+	}
+	if (pool) {
+		// Outside of the global lock, so that submitting threads only contend on the queues
+		pool->Push(task);
+		pool->mSubmitting--;
+		return;
+	}
+	// A pool started now would never be terminated
+	CONSOLE_WARNING("Task submitted while terminating the thread pool, running it on the calling thread\n");
+	task->Run();
+}
+
+void CThreadPool::Terminate() {
+	CThreadPool *pool;
+	{
+		CMutex::ScopedLock lock (g_threadPoolMutex);
+		pool = g_threadPool;
+		g_threadPool = NULL;
+		g_threadPoolTerminating = true;
+	}
+	if (pool) {
+		// No Submit can take the pool anymore; those which did are about to push their task, which must run too
+		while (pool->mSubmitting > 0) {
+			std::this_thread::yield();
+		}
+		delete pool;
+	}
+	CMutex::ScopedLock lock (g_threadPoolMutex);
+	g_threadPoolTerminating = false;
+}
+
+CThreadPool::CThreadPool(int threadCount) : mPending(0), mNextQueue(0), mSubmitting(0), mStopping(false) {
+	for (int i = 0; i < threadCount; i++) {
+		mQueues.push_back(new Queue);
+	}
+	for (int i = 0; i < threadCount; i++) {
+		mWorkers.push_back(new Worker(this, i));
+		mWorkers.back()->Start();
+	}
+}
+
+CThreadPool::~CThreadPool() {
+	mIdle.LockVar();
+	mStopping = true;
+	mIdle.SignalAll();
+	mIdle.UnlockVar();
+	for (size_t i = 0; i < mWorkers.size(); i++) {
+		mWorkers[i]->Join();
+		mWorkers[i]->Release();
+	}
+	// Only once no thread may take tasks from them anymore
+	for (size_t i = 0; i < mQueues.size(); i++) {
+		delete mQueues[i];
+	}
+}
+
+void CThreadPool::Push(CTask *task) {
+	Queue *queue = mQueues[mNextQueue++ % mQueues.size()];
+	queue->mutex.Lock();
+	queue->tasks.push_back(task);
+	queue->mutex.Unlock();
+	// Counted under the lock so that a thread about to wait can not miss it
+	mIdle.LockVar();
+	mPending++;
+	mIdle.SignalOne();
+	mIdle.UnlockVar();
+}
+
+CThreadPool::CTask *CThreadPool::Take(int queueIndex) {
+	// Own queue first, oldest task; then the newest task of another queue
+	for (size_t i = 0; i < mQueues.size(); i++) {
+		Queue *queue = mQueues[(queueIndex + i) % mQueues.size()];
+		CTask *task = NULL;
+		queue->mutex.Lock();
+		if (!queue->tasks.empty()) {
+			if (i == 0) {
+				task = queue->tasks.front(), queue->tasks.pop_front();
+			} else {
+				task = queue->tasks.back(), queue->tasks.pop_back();
+			}
+		}
+		queue->mutex.Unlock();
+		if (task) {
+			mPending--;
+			return task;
+		}
+	}
+	return NULL;
+}
+
+void CThreadPool::Work(int queueIndex) {
+	for (;;) {
+		CTask *task = Take(queueIndex);
+		if (task) {
+			task->Run();
+			continue;
+		}
+		// Nothing left: wait for the next task, unless terminating
+		mIdle.LockVar();
+		while (mPending <= 0 && !mStopping) {
+			mIdle.Wait();
+		}
+		bool stop = mPending <= 0 && mStopping;
+		mIdle.UnlockVar();
+		if (stop) { break; }
 	}
 }
 
@@ -9,6 +9,11 @@
 #ifndef XtraLife_thread_h
 #define XtraLife_thread_h
 
+#include <pthread.h>
+#include <atomic>
+#include <deque>
+#include <vector>
+
 #include "include/XtraLifeHelpers.h"
 
 namespace XtraLife {
@@ -30,8 +35,9 @@ namespace XtraLife {
             t->Release(); \endcode
          */
         class CThread : public CRefClass {
-            enum state {READY, RUNNING, COMPLETED} mState;
-            struct CThreadVars *mVars;
+            enum state {READY, RUNNING, COMPLETED, JOINED};
+            std::atomic<state> mState;
+            pthread_t mRunningThread;
 
             static void *startupRoutine(void * class_xlThread);
             void RunForInternalUse();
@@ -62,7 +68,7 @@ namespace XtraLife {
             /**
              * @return whether the thread has completed its work.
              */
-            bool HasFinished() { return mState == COMPLETED; }
+            bool HasFinished() { return mState >= COMPLETED; }
         };
 
         /**
@@ -70,8 +76,11 @@ namespace XtraLife {
          * Just call Lock when you want to access data, and Unlock when you are done.
          */
         class CMutex {
-            struct CMutexVars *mVars;
+            pthread_mutex_t mMutex;
             friend class CConditionVariable;
+            // Not allowed
+            CMutex(const CMutex &other);
+            CMutex& operator = (const CMutex &other);
 
         public:
             CMutex();
@@ -100,12 +109,64 @@ namespace XtraLife {
             };
         };
 
+        /**
+         * Lock letting any number of threads read shared data at once, while writing excludes everyone else. Prefer it over
+         * CMutex for data that is read much more often than it is modified.
+         */
+        class CReadWriteLock {
+            pthread_rwlock_t mLock;
+            // Not allowed
+            CReadWriteLock(const CReadWriteLock &other);
+            CReadWriteLock& operator = (const CReadWriteLock &other);
+
+        public:
+            CReadWriteLock();
+            ~CReadWriteLock();
+
+            void LockRead();
+            void LockWrite();
+            // Releases either kind of lock
+            void Unlock();
+
+            /**
+             * Same as CMutex::ScopedLock, for reading.
+             */
+            struct ScopedReadLock {
+                CReadWriteLock &lock;
+                ScopedReadLock(CReadWriteLock &lock) : lock(lock) { lock.LockRead(); }
+                ~ScopedReadLock() { lock.Unlock(); }
+            };
+            /**
+             * Same as CMutex::ScopedLock, for writing.
+             */
+            struct ScopedWriteLock {
+                CReadWriteLock &lock;
+                ScopedWriteLock(CReadWriteLock &lock) : lock(lock) { lock.LockWrite(); }
+                ~ScopedWriteLock() { lock.Unlock(); }
+            };
+            /**
+             * Same as CMutex::ConditionallyScopedLock, for writing.
+             */
+            struct ConditionallyScopedWriteLock {
+                CReadWriteLock *mLock;
+                ConditionallyScopedWriteLock(CReadWriteLock &lock, bool lockItOrNot) : mLock(lockItOrNot ? &lock : NULL) { if (mLock) { mLock->LockWrite(); } }
+                ~ConditionallyScopedWriteLock() { if (mLock) { mLock->Unlock(); } }
+            };
+        };
+
         /**
          * Basic condition variable. Prefer CProtectedVariable to protect content.
+         * Timeouts are measured on a monotonic clock where the platform allows, so that changing the time of the device
+         * doesn't affect them.
          */
         class CConditionVariable {
             CMutex mMutex;
-            struct CConditionVariableVars *mVars;
+            pthread_cond_t mCond;
+            // Threads in Wait: signaling when there are none costs nothing
+            std::atomic<int> mWaiters;
+            // Not allowed
+            CConditionVariable(const CConditionVariable &other);
+            CConditionVariable& operator = (const CConditionVariable &other);
 
         public:
             CConditionVariable();
@@ -174,6 +235,66 @@ namespace XtraLife {
             bool Wait(int timeoutMilliseconds = 0) { return mCondVar.Wait(timeoutMilliseconds); }
         };
 
+
+        /**
+         * Fixed set of threads running short tasks, so that no thread is created per task and the number of tasks running at
+         * once stays bounded. Tasks are spread among per-thread queues; a thread whose queue is empty takes tasks from the others. \code
+            struct MyTask: CThreadPool::CTask {
+                virtual void Run() {
+                    ...
+                    delete this;
+                }
+            };
+            CThreadPool::Submit(new MyTask); \endcode
+         */
+        class CThreadPool {
+        public:
+            struct CTask {
+                virtual ~CTask() {}
+                /**
+                 * Runs on one of the threads of the pool. The pool forgets about the task afterwards: delete it here if needed.
+                 */
+                virtual void Run() = 0;
+            };
+
+            /**
+             * Sets the number of threads, before the first task is submitted.
+             * @param threadCount number of threads, 0 for the number of cores
+             */
+            static void Configure(int threadCount);
+            /**
+             * Queues a task, starting the threads on first use. May be called from any thread. While Terminate runs, the task
+             * is run on the calling thread instead.
+             */
+            static void Submit(CTask *task);
+            /**
+             * Runs the tasks left and stops the threads. Tasks submitted once it returns start them again.
+             */
+            static void Terminate();
+
+        private:
+            struct Worker;
+            struct Queue {
+                CMutex mutex;
+                std::deque<CTask*> tasks;
+            };
+
+            std::vector<Worker*> mWorkers;
+            std::vector<Queue*> mQueues;
+            // Tasks in the queues, and threads waiting for one
+            CConditionVariable mIdle;
+            std::atomic<int> mPending;
+            std::atomic<unsigned> mNextQueue;
+            // Submit calls which took this pool and have yet to push their task; Terminate waits for them
+            std::atomic<int> mSubmitting;
+            bool mStopping;
+
+            CThreadPool(int threadCount);
+            ~CThreadPool();
+            void Push(CTask *task);
+            CTask *Take(int queueIndex);
+            void Work(int queueIndex);
+        };
     }
 }
 
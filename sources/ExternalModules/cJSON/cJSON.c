@@ -30,22 +30,18 @@
 #include <float.h>
 #include <limits.h>
 #include <ctype.h>
+#include <locale.h>
 #include "cJSON.h"
 
-static const char *ep;
+static const char *ep;	/* Error position of the last context-less parse (not thread safe, see cJSON_ParseWithContext). */
 
 const char *cJSON_GetErrorPtr(void) {return ep;}
 
-static int cJSON_strcasecmp(const char *s1,const char *s2)
-{
-	if (!s1) return (s1==s2)?0:1;if (!s2) return 1;
-	for(; tolower(*s1) == tolower(*s2); ++s1, ++s2)	if(*s1 == 0)	return 0;
-	return tolower(*(const unsigned char *)s1) - tolower(*(const unsigned char *)s2);
-}
-
 //	XtraLife MODIFICATION	//
 static void *(*cJSON_malloc)(size_t sz) = malloc;
 static void (*cJSON_free)(void *ptr) = free;
+/* Only usable when the hooks are the standard allocator, else NULL (buffers are then grown by copying). */
+static void *(*cJSON_realloc)(void *ptr,size_t sz) = realloc;
 //	XtraLife MODIFICATION	//
 
 static char* cJSON_strdup(const char* str)
@@ -59,18 +55,104 @@ static char* cJSON_strdup(const char* str)
 	  return copy;
 }
 
+//	XtraLife MODIFICATION	//
+/* Keys which recur in the requests and responses of the API. Objects point to these shared copies (flagged
+   cJSON_StringIsConst) rather than allocating their own, and lookups with the same pointer match at once.
+   Must stay sorted in strcmp order. */
+static const char *const interned_keys[]={
+	"_curlerror","_error","_httpcode","_id","_type","count","currency","customData","data","description",
+	"device","displayName","domain","email","env","event","full","gamerId","gamerSecret","gamer_id",
+	"gamer_secret","getURL","globalState","id","index","info","internalProductId","key","lang","lastEventId",
+	"limit","match","matches","mayvary","mode","model","move","moves","name","network","networkid",
+	"networksecret","objectid","options","order","osn","osname","osversion","page","participating","payload",
+	"players","price","productId","products","profile","properties","putURL","q","query","result","score",
+	"sdkVersion","search","secret","seed","shoe","skip","status","transaction","type","unit","url","value",
+	"version"
+};
+#define INTERNED_KEY_MAX 17	/* Length of the longest one. */
+
+/* The interned copy of the len first characters of string (which may hold NULs), if any. */
+static const char *intern(const char *string,size_t len)
+{
+	int lo=0,hi=(int)(sizeof(interned_keys)/sizeof(*interned_keys))-1;
+	if (len>INTERNED_KEY_MAX) return 0;
+	while (lo<=hi)
+	{
+		int mid=(lo+hi)/2;size_t klen=strlen(interned_keys[mid]);
+		int c=memcmp(interned_keys[mid],string,klen<len?klen:len);
+		if (!c) c=(klen>len)-(klen<len);
+		if (!c) return interned_keys[mid];
+		if (c<0) lo=mid+1; else hi=mid-1;
+	}
+	return 0;
+}
+
+/* Length of a key, and its FNV-1a hash through *hash. */
+static int key_hash(const char *string,unsigned *hash)
+{
+	const char *p=string;unsigned h=2166136261u;
+	if (p) for (;*p;p++) h=(h^(unsigned char)*p)*16777619u;
+	*hash=h;
+	return (int)(p-string);
+}
+
+/* Attaches a key to item (without copying it), along with its length and hash. */
+static void set_key(cJSON *item,char *string)
+{
+	item->string=string;
+	item->keylen=key_hash(string,&item->keyhash);
+}
+
+/* Names item, sharing the interned copy of the name when there is one. */
+static int set_name(cJSON *item,const char *string)
+{
+	const char *interned=string?intern(string,strlen(string)):0;
+	char *copy=interned?(char*)interned:string?cJSON_strdup(string):0;	/* Before freeing: string may be item->string. */
+	if (string && !copy) return 0;
+	if (item->string && !(item->type&cJSON_StringIsConst)) cJSON_free(item->string);
+	set_key(item,copy);
+	if (interned) item->type|=cJSON_StringIsConst; else item->type&=~cJSON_StringIsConst;
+	return 1;
+}
+
+/* Matches the key of item with string (of length len and hash hash): at once when both are the same (interned) copy,
+   else the length and hash rule out nearly all other keys before any character is compared. Case sensitive. */
+#define key_matches(item,string,len,hash)	((item)->string==(string) || ((string) && (item)->keyhash==(hash) && (item)->keylen==(len) && !memcmp((item)->string,(string),(len))))
+
+/* The item of object named string, and its position through *index. */
+static cJSON *find_key(cJSON *object,const char *string,int *index)
+{
+	cJSON *c=object->child;unsigned hash;int len=key_hash(string,&hash),i=0;
+	while (c && !key_matches(c,string,len,hash)) i++,c=c->next;
+	if (index) *index=i;
+	return c;
+}
+//	XtraLife MODIFICATION	//
+
 void cJSON_InitHooks(cJSON_Hooks* hooks)
 {
 	if (!hooks) { /* Reset hooks */
 		cJSON_malloc = malloc;
 		cJSON_free = free;
+		cJSON_realloc = realloc;
 		return;
 	}
 
 	cJSON_malloc = (hooks->malloc_fn)?hooks->malloc_fn:malloc;
 	cJSON_free	 = (hooks->free_fn)?hooks->free_fn:free;
+	cJSON_realloc = (cJSON_malloc==malloc && cJSON_free==free)?realloc:0;
 }
 
+//	XtraLife MODIFICATION	//
+/* Appends item to the children of parent in constant time: the prev of the first child points to the last one. */
+static void add_tail(cJSON *parent,cJSON *item)
+{
+	cJSON *first=parent->child;
+	if (!first) {parent->child=item;item->prev=item;return;}
+	first->prev->next=item;item->prev=first->prev;first->prev=item;
+}
+//	XtraLife MODIFICATION	//
+
 /* Internal constructor. */
 static cJSON *cJSON_New_Item()
 {
@@ -79,86 +161,342 @@ static cJSON *cJSON_New_Item()
 	return node;
 }
 
-/* Delete a cJSON structure. */
-void cJSON_Delete(cJSON *c)
+/* Per-call parser state: parsing reads and writes nothing global, so it may run on several threads at once. */
+typedef struct {void *(*malloc_fn)(size_t sz);void (*free_fn)(void *ptr);const char *error;int depth;int max_depth;int insitu;} parser;
+
+static cJSON *parser_new_item(parser *ctx)
+{
+	cJSON* node = (cJSON*)ctx->malloc_fn(sizeof(cJSON));
+	if (node) memset(node,0,sizeof(cJSON));
+	return node;
+}
+
+/* Delete a cJSON structure whose nodes were allocated by the counterpart of free_fn. */
+static void delete_tree(cJSON *c,void (*free_fn)(void *ptr))
 {
 	cJSON *next;
 	while (c)
 	{
 		next=c->next;
-		if (!(c->type&cJSON_IsReference) && c->child) cJSON_Delete(c->child);
-		if (!(c->type&cJSON_IsReference) && c->valuestring) cJSON_free(c->valuestring);
-		if (c->string) cJSON_free(c->string);
-		cJSON_free(c);
+		if (!(c->type&cJSON_IsReference) && c->child) delete_tree(c->child,free_fn);
+		if (!(c->type&(cJSON_IsReference|cJSON_ValueStringIsConst)) && c->valuestring) free_fn(c->valuestring);
+		if (!(c->type&cJSON_StringIsConst) && c->string) free_fn(c->string);
+		free_fn(c);
 		c=next;
 	}
 }
 
+/* Delete a cJSON structure. */
+void cJSON_Delete(cJSON *c)	{delete_tree(c,cJSON_free);}
+void cJSON_DeleteWithHooks(cJSON *c,cJSON_Hooks *hooks)	{delete_tree(c,(hooks && hooks->free_fn)?hooks->free_fn:cJSON_free);}
+
+//	XtraLife MODIFICATION	//
+/*
+ * Vectorized scanning of the input. The SIMD variants process 16 (SSE2, NEON) or 32 (AVX2) bytes at a time; AVX2 is
+ * selected at runtime when the CPU supports it. Loads are aligned, so reading past the terminating NUL never crosses
+ * a page boundary (but does read outside of the allocation, hence the sanitizer exemption).
+ */
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define CJSON_SSE2
+#include <emmintrin.h>
+#if defined(__GNUC__) && !defined(CJSON_NO_AVX2)
+#define CJSON_AVX2
+#include <immintrin.h>
+#endif
+#elif (defined(__ARM_NEON) || defined(__ARM_NEON__)) && defined(__GNUC__)
+#define CJSON_NEON
+#include <arm_neon.h>
+#endif
+
+#if defined(__clang__) || (defined(__GNUC__) && __GNUC__ >= 5)
+#define CJSON_NO_SANITIZE __attribute__((no_sanitize_address))
+#else
+#define CJSON_NO_SANITIZE
+#endif
+
+#ifdef _MSC_VER
+#include <intrin.h>
+static int cjson_ctz(unsigned x) {unsigned long i;_BitScanForward(&i,x);return (int)i;}
+#else
+#define cjson_ctz(x) __builtin_ctz(x)
+#endif
+
+#if !defined(CJSON_SSE2) && !defined(CJSON_NEON)
+/* Scalar versions: first quote, backslash or NUL / first byte which is not whitespace (NUL included). */
+static const char *scan_string_scalar(const char *p)		{while (*p!='\"' && *p!='\\' && *p) p++; return p;}
+static const char *scan_whitespace_scalar(const char *p)	{while (*p && (unsigned char)*p<=32) p++; return p;}
+#endif
+
+#if defined(CJSON_SSE2)
+CJSON_NO_SANITIZE static const char *scan_string_sse2(const char *p)
+{
+	const __m128i quote=_mm_set1_epi8('\"'),backslash=_mm_set1_epi8('\\'),zero=_mm_setzero_si128();
+	while (((size_t)p&15) && *p!='\"' && *p!='\\' && *p) p++;
+	if ((size_t)p&15) return p;
+	for (;;p+=16)
+	{
+		__m128i v=_mm_load_si128((const __m128i*)p);
+		int mask=_mm_movemask_epi8(_mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(v,quote),_mm_cmpeq_epi8(v,backslash)),_mm_cmpeq_epi8(v,zero)));
+		if (mask) return p+cjson_ctz(mask);
+	}
+}
+
+CJSON_NO_SANITIZE static const char *scan_whitespace_sse2(const char *p)
+{
+	const __m128i min=_mm_set1_epi8(33),zero=_mm_setzero_si128();
+	while (((size_t)p&15) && *p && (unsigned char)*p<=32) p++;
+	if ((size_t)p&15) return p;
+	for (;;p+=16)
+	{
+		__m128i v=_mm_load_si128((const __m128i*)p);	/* max(v,33)==v <=> v>32 (unsigned) */
+		int mask=_mm_movemask_epi8(_mm_or_si128(_mm_cmpeq_epi8(_mm_max_epu8(v,min),v),_mm_cmpeq_epi8(v,zero)));
+		if (mask) return p+cjson_ctz(mask);
+	}
+}
+#endif
+
+#if defined(CJSON_AVX2)
+CJSON_NO_SANITIZE __attribute__((target("avx2"))) static const char *scan_string_avx2(const char *p)
+{
+	const __m256i quote=_mm256_set1_epi8('\"'),backslash=_mm256_set1_epi8('\\'),zero=_mm256_setzero_si256();
+	while (((size_t)p&31) && *p!='\"' && *p!='\\' && *p) p++;
+	if ((size_t)p&31) return p;
+	for (;;p+=32)
+	{
+		__m256i v=_mm256_load_si256((const __m256i*)p);
+		unsigned mask=(unsigned)_mm256_movemask_epi8(_mm256_or_si256(_mm256_or_si256(_mm256_cmpeq_epi8(v,quote),_mm256_cmpeq_epi8(v,backslash)),_mm256_cmpeq_epi8(v,zero)));
+		if (mask) return p+cjson_ctz(mask);
+	}
+}
+
+CJSON_NO_SANITIZE __attribute__((target("avx2"))) static const char *scan_whitespace_avx2(const char *p)
+{
+	const __m256i min=_mm256_set1_epi8(33),zero=_mm256_setzero_si256();
+	while (((size_t)p&31) && *p && (unsigned char)*p<=32) p++;
+	if ((size_t)p&31) return p;
+	for (;;p+=32)
+	{
+		__m256i v=_mm256_load_si256((const __m256i*)p);
+		unsigned mask=(unsigned)_mm256_movemask_epi8(_mm256_or_si256(_mm256_cmpeq_epi8(_mm256_max_epu8(v,min),v),_mm256_cmpeq_epi8(v,zero)));
+		if (mask) return p+cjson_ctz(mask);
+	}
+}
+#endif
+
+#if defined(CJSON_NEON)
+/* Narrows a 0x00/0xFF byte mask to 4 bits per byte; the first match is at ctz/4. */
+static unsigned long long neon_mask(uint8x16_t m)	{return vget_lane_u64(vreinterpret_u64_u8(vshrn_n_u16(vreinterpretq_u16_u8(m),4)),0);}
+
+CJSON_NO_SANITIZE static const char *scan_string_neon(const char *p)
+{
+	while (((size_t)p&15) && *p!='\"' && *p!='\\' && *p) p++;
+	if ((size_t)p&15) return p;
+	for (;;p+=16)
+	{
+		uint8x16_t v=vld1q_u8((const uint8_t*)p);
+		unsigned long long mask=neon_mask(vorrq_u8(vorrq_u8(vceqq_u8(v,vdupq_n_u8('\"')),vceqq_u8(v,vdupq_n_u8('\\'))),vceqq_u8(v,vdupq_n_u8(0))));
+		if (mask) return p+(__builtin_ctzll(mask)>>2);
+	}
+}
+
+CJSON_NO_SANITIZE static const char *scan_whitespace_neon(const char *p)
+{
+	while (((size_t)p&15) && *p && (unsigned char)*p<=32) p++;
+	if ((size_t)p&15) return p;
+	for (;;p+=16)
+	{
+		uint8x16_t v=vld1q_u8((const uint8_t*)p);
+		unsigned long long mask=neon_mask(vorrq_u8(vcgtq_u8(v,vdupq_n_u8(32)),vceqq_u8(v,vdupq_n_u8(0))));
+		if (mask) return p+(__builtin_ctzll(mask)>>2);
+	}
+}
+#endif
+
+/* Initialized statically so that concurrent parsers never race on picking them. */
+#if defined(CJSON_SSE2)
+static const char *(*scan_string)(const char *p)=scan_string_sse2;
+static const char *(*scan_whitespace)(const char *p)=scan_whitespace_sse2;
+#elif defined(CJSON_NEON)
+static const char *(*scan_string)(const char *p)=scan_string_neon;
+static const char *(*scan_whitespace)(const char *p)=scan_whitespace_neon;
+#else
+static const char *(*scan_string)(const char *p)=scan_string_scalar;
+static const char *(*scan_whitespace)(const char *p)=scan_whitespace_scalar;
+#endif
+#if defined(CJSON_AVX2)
+/* Upgraded once at load time, before any thread can parse. */
+__attribute__((constructor)) static void scan_select(void)
+{
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("avx2")) {scan_whitespace=scan_whitespace_avx2;scan_string=scan_string_avx2;}
+}
+#endif
+//	XtraLife MODIFICATION	//
+
+/* Powers of ten which are exactly representable as a double. */
+static const double exact_pow10[]={1e0,1e1,1e2,1e3,1e4,1e5,1e6,1e7,1e8,1e9,1e10,1e11,1e12,1e13,1e14,1e15,1e16,1e17,1e18,1e19,1e20,1e21,1e22};
+
+/* The decimal separator used by strtod/sprintf in the current C locale. */
+static char decimal_point(void) {struct lconv *lc=localeconv();return (lc && lc->decimal_point && *lc->decimal_point)?*lc->decimal_point:'.';}
+
+/* Correctly rounded conversion of len chars of JSON number text, regardless of the C locale. */
+static double parse_double(const char *num,size_t len,parser *ctx)
+{
+	char local[64],*copy=local,point=decimal_point();size_t i;double d;
+	if (point=='.') return strtod(num,0);
+	if (len>=sizeof(local) && !(copy=(char*)ctx->malloc_fn(len+1))) return 0;
+	for (i=0;i<len;i++) copy[i]=(num[i]=='.')?point:num[i];
+	copy[len]=0;d=strtod(copy,0);
+	if (copy!=local) ctx->free_fn(copy);
+	return d;
+}
+
+/* Fills the number fields of item from a double. */
+static void set_number(cJSON *item,double d)
+{
+	item->valuedouble=d;
+	if (d!=d)	item->valueint=0,item->valueint64=0;	/* NaN */
+	else		item->valueint=d>=INT_MAX?INT_MAX:d<=INT_MIN?INT_MIN:(int)d,
+				item->valueint64=d>=9223372036854775807.0?LLONG_MAX:d<=-9223372036854775808.0?LLONG_MIN:(long long)d;
+	item->type=cJSON_Number;
+}
+
 /* Parse the input text to generate a number, and populate the result into item. */
-static const char *parse_number(cJSON *item,const char *num)
+static const char *parse_number(cJSON *item,const char *num,parser *ctx)
 {
-	double n=0,sign=1,scale=0;int subscale=0,signsubscale=1;
+	const char *start=num;unsigned long long m=0;
+	int digits=0,inexact=0,isint=1,neg=0,scale=0,subscale=0,signsubscale=1;
 
-	/* Could use sscanf for this? */
-	if (*num=='-') sign=-1,num++;	/* Has sign? */
+	/* Up to 19 significant digits are accumulated exactly in m. */
+	if (*num=='-') neg=1,num++;	/* Has sign? */
 	if (*num=='0') num++;			/* is zero */
-	if (*num>='1' && *num<='9')	do	n=(n*10.0)+(*num++ -'0');	while (*num>='0' && *num<='9');	/* Number? */
-	if (*num=='.') {num++;		do	n=(n*10.0)+(*num++ -'0'),scale--; while (*num>='0' && *num<='9');}	/* Fractional part? */
+	if (*num>='1' && *num<='9')	do	{if (digits<19) m=m*10+(*num-'0'),digits++; else scale++,inexact=1;num++;}	while (*num>='0' && *num<='9');	/* Number? */
+	if (*num=='.' && num[1]>='0' && num[1]<='9')	/* Fractional part? */
+	{	num++;isint=0;
+		do	{if (digits<19) {m=m*10+(*num-'0');if (m) digits++;scale--;} else inexact=1;num++;}	while (*num>='0' && *num<='9');
+	}
 	if (*num=='e' || *num=='E')		/* Exponent? */
-	{	num++;if (*num=='+') num++;	else if (*num=='-') signsubscale=-1,num++;		/* With sign? */
-		while (*num>='0' && *num<='9') subscale=(subscale*10)+(*num++ - '0');	/* Number? */
+	{	num++;isint=0;if (*num=='+') num++;	else if (*num=='-') signsubscale=-1,num++;		/* With sign? */
+		while (*num>='0' && *num<='9') {if (subscale<100000) subscale=(subscale*10)+(*num-'0');num++;}	/* Number? */
 	}
+	scale+=subscale*signsubscale;
 
-	n=sign*n*pow(10.0,(scale+subscale*signsubscale));	/* number = +/- number.fraction * 10^+/- exponent */
-	
-	item->valuedouble=n;
-	item->valueint=(int)n;
-	item->type=cJSON_Number;
+	if (isint && !inexact && m<=(neg?9223372036854775808ULL:9223372036854775807ULL))
+	{	/* Integers are kept exactly, whatever their magnitude. */
+		set_number(item,neg?-(double)m:(double)m);
+		item->valueint64=neg?-(long long)(m-1)-1:(long long)m;
+		item->type|=cJSON_IsInt64;
+	}
+	else if (!inexact && m<=(1ULL<<53) && scale>=-22 && scale<=22)
+		/* Both operands are exact, so a single IEEE operation gives the correctly rounded result. */
+		set_number(item,(neg?-1.0:1.0)*(scale<0?(double)m/exact_pow10[-scale]:(double)m*exact_pow10[scale]));
+	else
+		set_number(item,parse_double(start,num-start,ctx));
 	return num;
 }
 
-/* Render the number nicely from the given item into a string. */
-static char *print_number(cJSON *item)
+/* Output buffer which all the print functions append to; grown as needed. */
+typedef struct {char *buffer;size_t length;size_t offset;} printbuffer;
+
+/* Makes room for needed more bytes at the current offset. Returns a pointer to write them to, or 0 on memory failure. */
+static char *ensure(printbuffer *p,size_t needed)
 {
-	char *str;
-	double d=item->valuedouble;
-	if (fabs(((double)item->valueint)-d)<=DBL_EPSILON && d<=INT_MAX && d>=INT_MIN)
+	char *newbuffer;size_t newsize;
+	needed+=p->offset;
+	if (needed<=p->length) return p->buffer+p->offset;
+
+	newsize=p->length*2;
+	if (newsize<needed) newsize=needed+256;
+	if (cJSON_realloc)
 	{
-		str=(char*)cJSON_malloc(21);	/* 2^64+1 can be represented in 21 chars. */
-		if (str) sprintf(str,"%d",item->valueint);
+		if (!(newbuffer=(char*)cJSON_realloc(p->buffer,newsize))) return 0;
 	}
 	else
 	{
-		str=(char*)cJSON_malloc(64);	/* This is a nice tradeoff. */
-		if (str)
-		{
-			if (fabs(floor(d)-d)<=DBL_EPSILON)			sprintf(str,"%.0f",d);
-			else if (fabs(d)<1.0e-6 || fabs(d)>1.0e9)	sprintf(str,"%e",d);
-			else										sprintf(str,"%f",d);
-		}
+		if (!(newbuffer=(char*)cJSON_malloc(newsize))) return 0;
+		if (p->buffer) {memcpy(newbuffer,p->buffer,p->offset);cJSON_free(p->buffer);}
 	}
-	return str;
+	p->length=newsize;p->buffer=newbuffer;
+	return newbuffer+p->offset;
+}
+
+/* Appends a NUL-terminated literal. */
+static int print_raw(printbuffer *p,const char *str,size_t len)
+{
+	char *out=ensure(p,len+1);
+	if (!out) return 0;
+	memcpy(out,str,len+1);p->offset+=len;
+	return 1;
+}
+
+/* Render the number nicely from the given item into a string. */
+static int print_number(cJSON *item,printbuffer *p)
+{
+	char *str=ensure(p,64),*ptr,point;	/* This is a nice tradeoff. */
+	double d=item->valuedouble;
+	if (!str) return 0;
+	if (item->type&cJSON_IsInt64)					p->offset+=sprintf(str,"%lld",item->valueint64);
+	else if (d!=d || d-d!=0)						p->offset+=sprintf(str,"null");	/* NaN and infinities have no JSON representation. */
+	else if (d==(double)item->valueint)				p->offset+=sprintf(str,"%d",item->valueint);
+	else if (floor(d)==d && fabs(d)<1.0e60)			p->offset+=sprintf(str,"%.0f",d);
+	else
+	{	/* Shortest of 15 or 17 significant digits which reads back as the same double. */
+		sprintf(str,"%.15g",d);
+		if (strtod(str,0)!=d) sprintf(str,"%.17g",d);
+		if ((point=decimal_point())!='.' && (ptr=strchr(str,point))) *ptr='.';
+		p->offset+=strlen(str);
+	}
+	return 1;
+}
+
+/* Reads the 4 hex digits of a \u escape into *uc. Returns how many there are, fewer if the input is malformed or ends. */
+static int parse_hex4(const char *str,unsigned *uc)
+{
+	int i;unsigned h;
+	*uc=0;
+	for (i=0;i<4;i++)
+	{
+		if (str[i]>='0' && str[i]<='9') h=str[i]-'0';
+		else if (str[i]>='a' && str[i]<='f') h=str[i]-'a'+10;
+		else if (str[i]>='A' && str[i]<='F') h=str[i]-'A'+10;
+		else break;
+		*uc=(*uc<<4)|h;
+	}
+	return i;
 }
 
 /* Parse the input text into an unescaped cstring, and populate item. */
 static const unsigned char firstByteMark[7] = { 0x00, 0x00, 0xC0, 0xE0, 0xF0, 0xF8, 0xFC };
-static const char *parse_string(cJSON *item,const char *str)
+static const char *parse_string(cJSON *item,const char *str,parser *ctx)
 {
-	const char *ptr=str+1;char *ptr2;char *out;int len=0;unsigned uc;
-	if (*str!='\"') {ep=str;return 0;}	/* not a string! */
+	const char *ptr=str+1,*end,*p;char *ptr2;char *out;int len,digits;unsigned uc;
+	if (*str!='\"') {ctx->error=str;return 0;}	/* not a string! */
 	
-	while (*ptr!='\"' && *ptr && ++len) if (*ptr++ == '\\') ptr++;	/* Skip escaped quotes. */
+	end=scan_string(ptr);	/* First quote, backslash or end of input. */
+	if (ctx->insitu)
+	{
+		/* The unescaped string is never longer than its escaped form, so write it over itself. */
+		out=(char*)str+1;
+	}
+	else
+	{
+		len=(int)(end-ptr);p=end;
+		while (*p!='\"' && *p && ++len) if (*p++ == '\\' && *p) p++;	/* Skip escaped quotes, but not the end of input. */
 	
-	out=(char*)cJSON_malloc(len+1);	/* This is how long we need for the string, roughly. */
-	if (!out) return 0;
+		out=(char*)ctx->malloc_fn(len+1);	/* This is how long we need for the string, roughly. */
+		if (!out) return 0;
+	}
 	
-	ptr=str+1;ptr2=out;
-	while (*ptr!='\"' && *ptr)
+	ptr2=out;
+	for (;;)
 	{
-		if (*ptr!='\\') *ptr2++=*ptr++;
-		else
+		/* ptr..end is a run of plain characters: copy it in one go (nothing to do in situ until the first escape). */
+		if (ptr2!=ptr) memmove(ptr2,ptr,end-ptr);
+		ptr2+=end-ptr;ptr=end;
+		if (*ptr!='\\') break;	/* Closing quote or end of input. */
 		{
 			ptr++;
+			if (!*ptr) break;	/* Dangling backslash at the end of input. */
 			switch (*ptr)
 			{
 				case 'b': *ptr2++='\b';	break;
@@ -167,7 +505,8 @@ static const char *parse_string(cJSON *item,const char *str)
 				case 'r': *ptr2++='\r';	break;
 				case 't': *ptr2++='\t';	break;
 				case 'u':	 /* transcode utf16 to utf8. DOES NOT SUPPORT SURROGATE PAIRS CORRECTLY. */
-					sscanf(ptr+1,"%4x",&uc);	/* get the unicode char. */
+					digits=parse_hex4(ptr+1,&uc);
+					if (digits<4) {ptr+=digits;break;}	/* Malformed: dropped, without reading past its digits. */
 					len=3;if (uc<0x80) len=1;else if (uc<0x800) len=2;ptr2+=len;
 					
 					switch (len) {
@@ -181,26 +520,28 @@ static const char *parse_string(cJSON *item,const char *str)
 			}
 			ptr++;
 		}
+		end=scan_string(ptr);
 	}
-	*ptr2=0;
 	if (*ptr=='\"') ptr++;
+	*ptr2=0;	/* In situ, this may overwrite the closing quote, which has already been consumed. */
 	item->valuestring=out;
 	item->type=cJSON_String;
+	if (ctx->insitu) item->type|=cJSON_ValueStringIsConst;
 	return ptr;
 }
 
 /* Render the cstring provided to an escaped version that can be printed. */
-static char *print_string_ptr(const char *str)
+static int print_string_ptr(const char *str,printbuffer *p)
 {
-	const char *ptr;char *ptr2,*out;int len=0;unsigned char token;
+	const char *ptr;char *ptr2;size_t len=0;unsigned char token;
 	
-	if (!str) return cJSON_strdup("");
+	if (!str) return print_raw(p,"\"\"",2);
 	ptr=str;while ((token=*ptr) && ++len) {if (strchr("\"\\\b\f\n\r\t",token)) len++; else if (token<32) len+=5;ptr++;}
 	
-	out=(char*)cJSON_malloc(len+3);
-	if (!out) return 0;
+	ptr2=ensure(p,len+3);
+	if (!ptr2) return 0;
 
-	ptr2=out;ptr=str;
+	ptr=str;
 	*ptr2++='\"';
 	while (*ptr)
 	{
@@ -221,284 +562,661 @@ static char *print_string_ptr(const char *str)
 			}
 		}
 	}
-	*ptr2++='\"';*ptr2++=0;
-	return out;
+	*ptr2++='\"';*ptr2=0;
+	p->offset+=len+2;
+	return 1;
 }
 /* Invote print_string_ptr (which is useful) on an item. */
-static char *print_string(cJSON *item)	{return print_string_ptr(item->valuestring);}
+static int print_string(cJSON *item,printbuffer *p)	{return print_string_ptr(item->valuestring,p);}
 
 /* Predeclare these prototypes. */
-static const char *parse_value(cJSON *item,const char *value);
-static char *print_value(cJSON *item,int depth,int fmt);
-static const char *parse_array(cJSON *item,const char *value);
-static char *print_array(cJSON *item,int depth,int fmt);
-static const char *parse_object(cJSON *item,const char *value);
-static char *print_object(cJSON *item,int depth,int fmt);
+static const char *parse_value(cJSON *item,const char *value,parser *ctx);
+static int print_value(cJSON *item,int depth,int fmt,printbuffer *p);
+static const char *parse_array(cJSON *item,const char *value,parser *ctx);
+static int print_array(cJSON *item,int depth,int fmt,printbuffer *p);
+static const char *parse_object(cJSON *item,const char *value,parser *ctx);
+static int print_object(cJSON *item,int depth,int fmt,printbuffer *p);
 
 /* Utility to jump whitespace and cr/lf */
-static const char *skip(const char *in) {while (in && *in && (unsigned char)*in<=32) in++; return in;}
+static const char *skip(const char *in) {if (in && *in && (unsigned char)*in<=32) in=scan_whitespace(in); return in;}
 
 /* Parse an object - create a new root, and populate. */
-cJSON *cJSON_Parse(const char *value)
+static cJSON *parse_root(const char *value,cJSON_Context *context,int insitu)
 {
-	cJSON *c=cJSON_New_Item();
-	ep=0;
-	if (!c) return 0;	   /* memory fail */
+	parser ctx;cJSON *c;
+	ctx.malloc_fn=(context && context->hooks.malloc_fn)?context->hooks.malloc_fn:cJSON_malloc;
+	ctx.free_fn=(context && context->hooks.free_fn)?context->hooks.free_fn:cJSON_free;
+	ctx.max_depth=(context && context->max_depth>0)?context->max_depth:CJSON_NESTING_LIMIT;
+	ctx.error=0;ctx.depth=0;ctx.insitu=insitu;
 
-	if (!parse_value(c,skip(value))) {cJSON_Delete(c);return 0;}
+	c=parser_new_item(&ctx);
+	if (c && !parse_value(c,skip(value),&ctx)) {delete_tree(c,ctx.free_fn);c=0;}
+	if (context) context->error=ctx.error; else ep=ctx.error;
 	return c;
 }
 
+cJSON *cJSON_Parse(const char *value)								{return parse_root(value,0,0);}
+cJSON *cJSON_ParseInSitu(char *value)								{return parse_root(value,0,1);}
+cJSON *cJSON_ParseWithContext(const char *value,cJSON_Context *context)	{return parse_root(value,context,0);}
+cJSON *cJSON_ParseInSituWithContext(char *value,cJSON_Context *context)	{return parse_root(value,context,1);}
+
+/* Parse a lone number (for streaming readers, which tokenize by themselves). */
+const char *cJSON_ParseNumber(cJSON *item,const char *value)
+{
+	parser ctx;
+	ctx.malloc_fn=cJSON_malloc;ctx.free_fn=cJSON_free;ctx.error=0;ctx.depth=0;ctx.max_depth=0;ctx.insitu=0;
+	if (!value || (*value!='-' && (*value<'0' || *value>'9'))) return 0;
+	return parse_number(item,value,&ctx);
+}
+
 /* Render a cJSON item/entity/structure to text. */
-char *cJSON_Print(cJSON *item)				{return print_value(item,0,1);}
-char *cJSON_PrintUnformatted(cJSON *item)	{return print_value(item,0,0);}
+static char *print_alloc(cJSON *item,int fmt)	{char *b=0;size_t l=0;if (cJSON_PrintIntoBuffer(item,&b,&l,fmt)) return b;cJSON_free(b);return 0;}
+char *cJSON_Print(cJSON *item)				{return print_alloc(item,1);}
+char *cJSON_PrintUnformatted(cJSON *item)	{return print_alloc(item,0);}
+
+/* Render into a caller owned buffer, growing it as needed. On failure the (possibly regrown) buffer is kept by the caller. */
+char *cJSON_PrintIntoBuffer(cJSON *item,char **buffer,size_t *capacity,int fmt)
+{
+	printbuffer p;
+	p.buffer=*buffer;p.length=p.buffer?*capacity:0;p.offset=0;
+	if (!ensure(&p,256) || !print_value(item,0,fmt,&p)) {*buffer=p.buffer;*capacity=p.length;return 0;}
+	*buffer=p.buffer;*capacity=p.length;
+	return p.buffer;
+}
 
 /* Parser core - when encountering text, process appropriately. */
-static const char *parse_value(cJSON *item,const char *value)
+static const char *parse_value(cJSON *item,const char *value,parser *ctx)
 {
 	if (!value)						return 0;	/* Fail on null. */
 	if (!strncmp(value,"null",4))	{ item->type=cJSON_NULL;  return value+4; }
 	if (!strncmp(value,"false",5))	{ item->type=cJSON_False; return value+5; }
 	if (!strncmp(value,"true",4))	{ item->type=cJSON_True; item->valueint=1;	return value+4; }
-	if (*value=='\"')				{ return parse_string(item,value); }
-	if (*value=='-' || (*value>='0' && *value<='9'))	{ return parse_number(item,value); }
-	if (*value=='[')				{ return parse_array(item,value); }
-	if (*value=='{')				{ return parse_object(item,value); }
+	if (*value=='\"')				{ return parse_string(item,value,ctx); }
+	if (*value=='-' || (*value>='0' && *value<='9'))	{ return parse_number(item,value,ctx); }
+	if (*value=='[' || *value=='{')
+	{
+		if (ctx->depth>=ctx->max_depth) {ctx->error=value;return 0;}	/* Nested too deep: refuse rather than overflow the stack. */
+		ctx->depth++;
+		value=(*value=='[')?parse_array(item,value,ctx):parse_object(item,value,ctx);
+		ctx->depth--;
+		return value;
+	}
 
-	ep=value;return 0;	/* failure. */
+	ctx->error=value;return 0;	/* failure. */
 }
 
 /* Render a value to text. */
-static char *print_value(cJSON *item,int depth,int fmt)
+static int print_value(cJSON *item,int depth,int fmt,printbuffer *p)
 {
-	char *out=0;
 	if (!item) return 0;
 	switch ((item->type)&255)
 	{
-		case cJSON_NULL:	out=cJSON_strdup("null");	break;
-		case cJSON_False:	out=cJSON_strdup("false");break;
-		case cJSON_True:	out=cJSON_strdup("true"); break;
-		case cJSON_Number:	out=print_number(item);break;
-		case cJSON_String:	out=print_string(item);break;
-		case cJSON_Array:	out=print_array(item,depth,fmt);break;
-		case cJSON_Object:	out=print_object(item,depth,fmt);break;
+		case cJSON_NULL:	return print_raw(p,"null",4);
+		case cJSON_False:	return print_raw(p,"false",5);
+		case cJSON_True:	return print_raw(p,"true",4);
+		case cJSON_Number:	return print_number(item,p);
+		case cJSON_String:	return print_string(item,p);
+		case cJSON_Array:	return print_array(item,depth,fmt,p);
+		case cJSON_Object:	return print_object(item,depth,fmt,p);
 	}
-	return out;
+	return 0;
 }
 
 /* Build an array from input text. */
-static const char *parse_array(cJSON *item,const char *value)
+static const char *parse_array(cJSON *item,const char *value,parser *ctx)
 {
 	cJSON *child;
-	if (*value!='[')	{ep=value;return 0;}	/* not an array! */
+	if (*value!='[')	{ctx->error=value;return 0;}	/* not an array! */
 
 	item->type=cJSON_Array;
 	value=skip(value+1);
 	if (*value==']') return value+1;	/* empty array. */
 
-	item->child=child=cJSON_New_Item();
-	if (!item->child) return 0;		 /* memory fail */
-	value=skip(parse_value(child,skip(value)));	/* skip any spacing, get the value. */
+	if (!(child=parser_new_item(ctx))) return 0;		 /* memory fail */
+	add_tail(item,child);
+	value=skip(parse_value(child,skip(value),ctx));	/* skip any spacing, get the value. */
 	if (!value) return 0;
 
 	while (*value==',')
 	{
 		cJSON *new_item;
-		if (!(new_item=cJSON_New_Item())) return 0; 	/* memory fail */
-		child->next=new_item;new_item->prev=child;child=new_item;
-		value=skip(parse_value(child,skip(value+1)));
+		if (!(new_item=parser_new_item(ctx))) return 0; 	/* memory fail */
+		add_tail(item,new_item);child=new_item;
+		value=skip(parse_value(child,skip(value+1),ctx));
 		if (!value) return 0;	/* memory fail */
 	}
 
 	if (*value==']') return value+1;	/* end of array */
-	ep=value;return 0;	/* malformed. */
+	ctx->error=value;return 0;	/* malformed. */
 }
 
 /* Render an array to text */
-static char *print_array(cJSON *item,int depth,int fmt)
+static int print_array(cJSON *item,int depth,int fmt,printbuffer *p)
 {
-	char **entries;
-	char *out=0,*ptr,*ret;int len=5;
 	cJSON *child=item->child;
-	int numentries=0,i=0,fail=0;
 	
-	/* How many entries in the array? */
-	while (child) numentries++,child=child->next;
-	/* Allocate an array to hold the values for each */
-	entries=(char**)cJSON_malloc(numentries*sizeof(char*));
-	if (!entries) return 0;
-	memset(entries,0,numentries*sizeof(char*));
-	/* Retrieve all the results: */
-	child=item->child;
-	while (child && !fail)
+	if (!print_raw(p,"[",1)) return 0;
+	while (child)
 	{
-		ret=print_value(child,depth+1,fmt);
-		entries[i++]=ret;
-		if (ret) len+=strlen(ret)+2+(fmt?1:0); else fail=1;
+		if (!print_value(child,depth+1,fmt,p)) return 0;
 		child=child->next;
+		if (child && !print_raw(p,fmt?", ":",",fmt?2:1)) return 0;
 	}
-	
-	/* If we didn't fail, try to malloc the output string */
-	if (!fail) out=(char*)cJSON_malloc(len);
-	/* If that fails, we fail. */
-	if (!out) fail=1;
+	return print_raw(p,"]",1);
+}
 
-	/* Handle failure. */
-	if (fail)
+/* Build an object from the text. */
+/* Parse one "key":value member of an object into child. */
+static const char *parse_member(cJSON *child,const char *value,parser *ctx)
+{
+	const char *interned=0,*end=value+1;char *key;
+	/* Common keys without escapes are shared rather than copied (in situ, they cost nothing anyway). */
+	if (!ctx->insitu && *value=='\"')
 	{
-		for (i=0;i<numentries;i++) if (entries[i]) cJSON_free(entries[i]);
-		cJSON_free(entries);
-		return 0;
+		while (*end && *end!='\"' && *end!='\\' && end-value<=INTERNED_KEY_MAX) end++;
+		if (*end=='\"') interned=intern(value+1,end-value-1);
 	}
-	
-	/* Compose the output array. */
-	*out='[';
-	ptr=out+1;*ptr=0;
-	for (i=0;i<numentries;i++)
+	if (interned) {key=(char*)interned;value=skip(end+1);}
+	else
 	{
-		strcpy(ptr,entries[i]);ptr+=strlen(entries[i]);
-		if (i!=numentries-1) {*ptr++=',';if(fmt)*ptr++=' ';*ptr=0;}
-		cJSON_free(entries[i]);
+		value=skip(parse_string(child,value,ctx));
+		if (!value) return 0;
+		key=child->valuestring;child->valuestring=0;
+		if (!ctx->insitu) set_key(child,key);	/* In situ, the key is only attached once the value (which resets the type flags) is parsed. */
 	}
-	cJSON_free(entries);
-	*ptr++=']';*ptr++=0;
-	return out;	
+	if (*value!=':') {ctx->error=value;return 0;}	/* fail! */
+	value=skip(parse_value(child,skip(value+1),ctx));	/* skip any spacing, get the value. */
+	if (!value) return 0;
+	if (ctx->insitu || interned) set_key(child,key),child->type|=cJSON_StringIsConst;
+	return value;
 }
 
 /* Build an object from the text. */
-static const char *parse_object(cJSON *item,const char *value)
+static const char *parse_object(cJSON *item,const char *value,parser *ctx)
 {
 	cJSON *child;
-	if (*value!='{')	{ep=value;return 0;}	/* not an object! */
+	if (*value!='{')	{ctx->error=value;return 0;}	/* not an object! */
 	
 	item->type=cJSON_Object;
 	value=skip(value+1);
 	if (*value=='}') return value+1;	/* empty array. */
 	
-	item->child=child=cJSON_New_Item();
-	if (!item->child) return 0;
-	value=skip(parse_string(child,skip(value)));
-	if (!value) return 0;
-	child->string=child->valuestring;child->valuestring=0;
-	if (*value!=':') {ep=value;return 0;}	/* fail! */
-	value=skip(parse_value(child,skip(value+1)));	/* skip any spacing, get the value. */
-	if (!value) return 0;
+	if (!(child=parser_new_item(ctx))) return 0;
+	add_tail(item,child);
+	if (!(value=parse_member(child,value,ctx))) return 0;
 	
 	while (*value==',')
 	{
 		cJSON *new_item;
-		if (!(new_item=cJSON_New_Item()))	return 0; /* memory fail */
-		child->next=new_item;new_item->prev=child;child=new_item;
-		value=skip(parse_string(child,skip(value+1)));
-		if (!value) return 0;
-		child->string=child->valuestring;child->valuestring=0;
-		if (*value!=':') {ep=value;return 0;}	/* fail! */
-		value=skip(parse_value(child,skip(value+1)));	/* skip any spacing, get the value. */
-		if (!value) return 0;
+		if (!(new_item=parser_new_item(ctx)))	return 0; /* memory fail */
+		add_tail(item,new_item);child=new_item;
+		if (!(value=parse_member(child,skip(value+1),ctx))) return 0;
 	}
 	
 	if (*value=='}') return value+1;	/* end of array */
-	ep=value;return 0;	/* malformed. */
+	ctx->error=value;return 0;	/* malformed. */
 }
 
 /* Render an object to text. */
-static char *print_object(cJSON *item,int depth,int fmt)
+static int print_object(cJSON *item,int depth,int fmt,printbuffer *p)
 {
-	char **entries=0,**names=0;
-	char *out=0,*ptr,*ret,*str;int len=7,i=0,j;
+	char *ptr;int i;
 	cJSON *child=item->child;
-	int numentries=0,fail=0;
-	/* Count the number of entries. */
-	while (child) numentries++,child=child->next;
-	/* Allocate space for the names and the objects */
-	entries=(char**)cJSON_malloc(numentries*sizeof(char*));
-	if (!entries) return 0;
-	names=(char**)cJSON_malloc(numentries*sizeof(char*));
-	if (!names) {cJSON_free(entries);return 0;}
-	memset(entries,0,sizeof(char*)*numentries);
-	memset(names,0,sizeof(char*)*numentries);
-
-	/* Collect all the results into our arrays: */
-	child=item->child;depth++;if (fmt) len+=depth;
+
+	depth++;
+	if (!print_raw(p,fmt?"{\n":"{",fmt?2:1)) return 0;
 	while (child)
 	{
-		names[i]=str=print_string_ptr(child->string);
-		entries[i++]=ret=print_value(child,depth,fmt);
-		if (str && ret) len+=strlen(ret)+strlen(str)+2+(fmt?2+depth:0); else fail=1;
+		if (fmt) {if (!(ptr=ensure(p,depth))) return 0; for (i=0;i<depth;i++) *ptr++='\t'; p->offset+=depth;}
+		if (!print_string_ptr(child->string,p)) return 0;
+		if (!print_raw(p,fmt?": ":":",fmt?2:1)) return 0;
+		if (!print_value(child,depth,fmt,p)) return 0;
 		child=child->next;
+		if (child && !print_raw(p,",",1)) return 0;
+		if (fmt && !print_raw(p,"\n",1)) return 0;
 	}
-	
-	/* Try to allocate the output string */
-	if (!fail) out=(char*)cJSON_malloc(len);
-	if (!out) fail=1;
-
-	/* Handle failure */
-	if (fail)
-	{
-		for (i=0;i<numentries;i++) {if (names[i]) cJSON_free(names[i]);if (entries[i]) cJSON_free(entries[i]);}
-		cJSON_free(names);cJSON_free(entries);
-		return 0;
-	}
-	
-	/* Compose the output: */
-	*out='{';ptr=out+1;if (fmt)*ptr++='\n';*ptr=0;
-	for (i=0;i<numentries;i++)
-	{
-		if (fmt) for (j=0;j<depth;j++) *ptr++='\t';
-		strcpy(ptr,names[i]);ptr+=strlen(names[i]);
-		*ptr++=':';if (fmt) *ptr++=' ';
-		strcpy(ptr,entries[i]);ptr+=strlen(entries[i]);
-		if (i!=numentries-1) *ptr++=',';
-		if (fmt) *ptr++='\n';*ptr=0;
-		cJSON_free(names[i]);cJSON_free(entries[i]);
-	}
-	
-	cJSON_free(names);cJSON_free(entries);
-	if (fmt) for (i=0;i<depth-1;i++) *ptr++='\t';
-	*ptr++='}';*ptr++=0;
-	return out;	
+	if (fmt) {if (!(ptr=ensure(p,depth))) return 0; for (i=0;i<depth-1;i++) *ptr++='\t'; p->offset+=depth-1;}
+	return print_raw(p,"}",1);
 }
 
 /* Get Array size/item / object item. */
 int	cJSON_GetArraySize(cJSON *array)							{cJSON *c=array->child;int i=0;while(c)i++,c=c->next;return i;}
 cJSON *cJSON_GetArrayItem(cJSON *array,int item)				{cJSON *c=array->child;  while (c && item>0) item--,c=c->next; return c;}
-cJSON *cJSON_GetObjectItem(cJSON *object,const char *string)	{cJSON *c=object->child; while (c && cJSON_strcasecmp(c->string,string)) c=c->next; return c;}
+cJSON *cJSON_GetObjectItem(cJSON *object,const char *string)	{return find_key(object,string,0);}
 
 /* Utility for array list handling. */
-static void suffix_object(cJSON *prev,cJSON *item) {prev->next=item;item->prev=prev;}
 /* Utility for handling references. */
-static cJSON *create_reference(cJSON *item) {cJSON *ref=cJSON_New_Item();if (!ref) return 0;memcpy(ref,item,sizeof(cJSON));ref->string=0;ref->type|=cJSON_IsReference;ref->next=ref->prev=0;return ref;}
+static cJSON *create_reference(cJSON *item) {cJSON *ref=cJSON_New_Item();if (!ref) return 0;memcpy(ref,item,sizeof(cJSON));ref->string=0;ref->type=(ref->type&~cJSON_StringIsConst)|cJSON_IsReference;ref->next=ref->prev=0;return ref;}
 
 /* Add item to array/object. */
-void   cJSON_AddItemToArray(cJSON *array, cJSON *item)						{cJSON *c=array->child;if (!item) return; if (!c) {array->child=item;} else {while (c && c->next) c=c->next; suffix_object(c,item);}}
-void   cJSON_AddItemToObject(cJSON *object,const char *string,cJSON *item)	{if (!item) return; if (item->string) cJSON_free(item->string);item->string=cJSON_strdup(string);cJSON_AddItemToArray(object,item);}
+void   cJSON_AddItemToArray(cJSON *array, cJSON *item)						{if (item) add_tail(array,item);}
+void   cJSON_AddItemsToArray(cJSON *array, cJSON *from)						{cJSON *first=from->child,*last;if (!first) return;last=first->prev;from->child=0;
+	if (!array->child) {array->child=first;return;}
+	array->child->prev->next=first;first->prev=array->child->prev;array->child->prev=last;}
+void   cJSON_AddItemToObject(cJSON *object,const char *string,cJSON *item)	{if (!item) return; set_name(item,string);cJSON_AddItemToArray(object,item);}
 void	cJSON_AddItemReferenceToArray(cJSON *array, cJSON *item)						{cJSON_AddItemToArray(array,create_reference(item));}
 void	cJSON_AddItemReferenceToObject(cJSON *object,const char *string,cJSON *item)	{cJSON_AddItemToObject(object,string,create_reference(item));}
 
 cJSON *cJSON_DetachItemFromArray(cJSON *array,int which)			{cJSON *c=array->child;while (c && which>0) c=c->next,which--;if (!c) return 0;
-	if (c->prev) c->prev->next=c->next;if (c->next) c->next->prev=c->prev;if (c==array->child) array->child=c->next;c->prev=c->next=0;return c;}
+	if (c!=array->child) c->prev->next=c->next;
+	if (c->next) c->next->prev=c->prev; else if (c!=array->child) array->child->prev=c->prev;	/* The last one: the first item points to the new last. */
+	if (c==array->child) array->child=c->next;
+	c->prev=c->next=0;return c;}
 void   cJSON_DeleteItemFromArray(cJSON *array,int which)			{cJSON_Delete(cJSON_DetachItemFromArray(array,which));}
-cJSON *cJSON_DetachItemFromObject(cJSON *object,const char *string) {int i=0;cJSON *c=object->child;while (c && cJSON_strcasecmp(c->string,string)) i++,c=c->next;if (c) return cJSON_DetachItemFromArray(object,i);return 0;}
+cJSON *cJSON_DetachItemFromObject(cJSON *object,const char *string) {int i;cJSON *c=find_key(object,string,&i);if (c) return cJSON_DetachItemFromArray(object,i);return 0;}
 void   cJSON_DeleteItemFromObject(cJSON *object,const char *string) {cJSON_Delete(cJSON_DetachItemFromObject(object,string));}
 
 /* Replace array/object items with new ones. */
+void   cJSON_InsertItemInArray(cJSON *array,int which,cJSON *newitem)		{cJSON *c=array->child;while (c && which>0) c=c->next,which--;if (!c) {cJSON_AddItemToArray(array,newitem);return;}
+	newitem->next=c;newitem->prev=c->prev;c->prev=newitem;if (c==array->child) array->child=newitem; else newitem->prev->next=newitem;}
 void   cJSON_ReplaceItemInArray(cJSON *array,int which,cJSON *newitem)		{cJSON *c=array->child;while (c && which>0) c=c->next,which--;if (!c) return;
-	newitem->next=c->next;newitem->prev=c->prev;if (newitem->next) newitem->next->prev=newitem;
+	newitem->next=c->next;newitem->prev=(c->prev==c)?newitem:c->prev;
+	if (newitem->next) newitem->next->prev=newitem; else if (c!=array->child) array->child->prev=newitem;
 	if (c==array->child) array->child=newitem; else newitem->prev->next=newitem;c->next=c->prev=0;cJSON_Delete(c);}
-void   cJSON_ReplaceItemInObject(cJSON *object,const char *string,cJSON *newitem){int i=0;cJSON *c=object->child;while(c && cJSON_strcasecmp(c->string,string))i++,c=c->next;if(c){newitem->string=cJSON_strdup(string);cJSON_ReplaceItemInArray(object,i,newitem);}}
+void   cJSON_ReplaceItemInObject(cJSON *object,const char *string,cJSON *newitem){int i;cJSON *c=find_key(object,string,&i);if(c){set_name(newitem,string);cJSON_ReplaceItemInArray(object,i,newitem);}}
 
 /* Create basic types: */
 cJSON *cJSON_CreateNull(void)						{cJSON *item=cJSON_New_Item();if(item)item->type=cJSON_NULL;return item;}
 cJSON *cJSON_CreateTrue(void)						{cJSON *item=cJSON_New_Item();if(item)item->type=cJSON_True;return item;}
 cJSON *cJSON_CreateFalse(void)						{cJSON *item=cJSON_New_Item();if(item)item->type=cJSON_False;return item;}
 cJSON *cJSON_CreateBool(int b)					{cJSON *item=cJSON_New_Item();if(item)item->type=b?cJSON_True:cJSON_False;return item;}
-cJSON *cJSON_CreateNumber(double num)			{cJSON *item=cJSON_New_Item();if(item){item->type=cJSON_Number;item->valuedouble=num;item->valueint=(int)num;}return item;}
+cJSON *cJSON_CreateNumber(double num)			{cJSON *item=cJSON_New_Item();if(item)set_number(item,num);return item;}
+cJSON *cJSON_CreateInt64(long long num)		{cJSON *item=cJSON_New_Item();if(item){set_number(item,(double)num);item->valueint64=num;item->type|=cJSON_IsInt64;}return item;}
 cJSON *cJSON_CreateString(const char *string)	{cJSON *item=cJSON_New_Item();if(item){item->type=cJSON_String;item->valuestring=cJSON_strdup(string);}return item;}
 cJSON *cJSON_CreateArray(void)						{cJSON *item=cJSON_New_Item();if(item)item->type=cJSON_Array;return item;}
 cJSON *cJSON_CreateObject(void)						{cJSON *item=cJSON_New_Item();if(item)item->type=cJSON_Object;return item;}
 
 /* Create Arrays: */
-cJSON *cJSON_CreateIntArray(int *numbers,int count)				{int i;cJSON *n=0,*p=0,*a=cJSON_CreateArray();for(i=0;a && i<count;i++){n=cJSON_CreateNumber(numbers[i]);if(!i)a->child=n;else suffix_object(p,n);p=n;}return a;}
-cJSON *cJSON_CreateFloatArray(float *numbers,int count)			{int i;cJSON *n=0,*p=0,*a=cJSON_CreateArray();for(i=0;a && i<count;i++){n=cJSON_CreateNumber(numbers[i]);if(!i)a->child=n;else suffix_object(p,n);p=n;}return a;}
-cJSON *cJSON_CreateDoubleArray(double *numbers,int count)		{int i;cJSON *n=0,*p=0,*a=cJSON_CreateArray();for(i=0;a && i<count;i++){n=cJSON_CreateNumber(numbers[i]);if(!i)a->child=n;else suffix_object(p,n);p=n;}return a;}
-cJSON *cJSON_CreateStringArray(const char **strings,int count)	{int i;cJSON *n=0,*p=0,*a=cJSON_CreateArray();for(i=0;a && i<count;i++){n=cJSON_CreateString(strings[i]);if(!i)a->child=n;else suffix_object(p,n);p=n;}return a;}
+cJSON *cJSON_CreateIntArray(int *numbers,int count)				{int i;cJSON *n=0,*a=cJSON_CreateArray();for(i=0;a && i<count;i++){n=cJSON_CreateNumber(numbers[i]);add_tail(a,n);}return a;}
+cJSON *cJSON_CreateFloatArray(float *numbers,int count)			{int i;cJSON *n=0,*a=cJSON_CreateArray();for(i=0;a && i<count;i++){n=cJSON_CreateNumber(numbers[i]);add_tail(a,n);}return a;}
+cJSON *cJSON_CreateDoubleArray(double *numbers,int count)		{int i;cJSON *n=0,*a=cJSON_CreateArray();for(i=0;a && i<count;i++){n=cJSON_CreateNumber(numbers[i]);add_tail(a,n);}return a;}
+cJSON *cJSON_CreateStringArray(const char **strings,int count)	{int i;cJSON *n=0,*a=cJSON_CreateArray();for(i=0;a && i<count;i++){n=cJSON_CreateString(strings[i]);add_tail(a,n);}return a;}
+
+/* Duplication: a fresh copy which owns all of its strings (or shares interned keys), whatever the original pointed to. */
+static cJSON *duplicate(cJSON *item,int recurse,int withname)
+{
+	cJSON *newitem,*child,*newchild;
+	if (!item || !(newitem=cJSON_New_Item())) return 0;
+	newitem->type=item->type&~(cJSON_IsReference|cJSON_StringIsConst|cJSON_ValueStringIsConst);
+	newitem->valueint=item->valueint;newitem->valuedouble=item->valuedouble;newitem->valueint64=item->valueint64;
+	if ((item->valuestring && !(newitem->valuestring=cJSON_strdup(item->valuestring))) || (withname && !set_name(newitem,item->string)))
+		{cJSON_Delete(newitem);return 0;}
+	if (!recurse) return newitem;
+	for (child=item->child;child;child=child->next)
+	{
+		if (!(newchild=duplicate(child,1,1))) {cJSON_Delete(newitem);return 0;}
+		add_tail(newitem,newchild);
+	}
+	return newitem;
+}
+cJSON *cJSON_Duplicate(cJSON *item,int recurse)	{return duplicate(item,recurse,0);}
+
+int cJSON_Compare(cJSON *a,cJSON *b)
+{
+	cJSON *c;int n=0;
+	if (!a || !b || (a->type&255)!=(b->type&255)) return 0;
+	switch (a->type&255)
+	{
+		case cJSON_Number:	return (a->type&b->type&cJSON_IsInt64)?a->valueint64==b->valueint64:a->valuedouble==b->valuedouble;
+		case cJSON_String:	return !strcmp(a->valuestring,b->valuestring);
+		case cJSON_Array:	for (a=a->child,b=b->child;a && b;a=a->next,b=b->next) if (!cJSON_Compare(a,b)) return 0;
+							return a==b;
+		case cJSON_Object:	for (c=a->child;c;c=c->next,n++) if (!cJSON_Compare(c,cJSON_GetObjectItem(b,c->string))) return 0;
+							return n==cJSON_GetArraySize(b);
+		default:			return 1;
+	}
+}
+
+//	XtraLife MODIFICATION	//
+/*
+ * Lazy parsing. The tape is a flat, depth-first list of the values of a document: containers record where their
+ * subtree ends, so that siblings can be walked without looking at the text again. Strings (keys included) are
+ * unescaped in place while the tape is built, so that reading never writes; numbers are converted each time they are read.
+ */
+#define TAPE_NO_KEY			0xFFFFFFFFu
+
+typedef struct {int type;int next;int count;unsigned key;unsigned text;} tape_entry;	/* next: index past the subtree; key/text: offsets in the text */
+struct cJSON_Tape {char *text;tape_entry *entries;int count;int capacity;void (*free_fn)(void *ptr);};
+
+/* Skips a string, returning past its closing quote, or 0 if it is not terminated. */
+static const char *tape_skip_string(const char *p)
+{
+	for (p=scan_string(p+1);*p=='\\';p=scan_string(p+2)) if (!p[1]) return 0;
+	return (*p=='\"')?p+1:0;
+}
+
+/* Unescapes a string in place, returning past its closing quote, or 0 if it is not terminated. */
+static const char *tape_parse_string(const char *p,parser *ctx)
+{
+	cJSON item;const char *end=tape_skip_string(p);
+	if (end) parse_string(&item,p,ctx);	/* Bounded by the closing quote found above, which the unescaped string never goes past. */
+	return end;
+}
+
+/* Skips what parse_number would consume. */
+static const char *tape_skip_number(const char *num)
+{
+	if (*num=='-') num++;
+	if (*num=='0') num++;
+	while (*num>='0' && *num<='9') num++;
+	if (*num=='.' && num[1]>='0' && num[1]<='9') {num++;while (*num>='0' && *num<='9') num++;}
+	if (*num=='e' || *num=='E') {num++;if (*num=='+' || *num=='-') num++;while (*num>='0' && *num<='9') num++;}
+	return num;
+}
+
+static tape_entry *tape_push(cJSON_Tape *tape,parser *ctx,int type,unsigned key,unsigned text)
+{
+	tape_entry *e;
+	if (tape->count==tape->capacity)
+	{
+		int capacity=tape->capacity*2;
+		if (!(e=(tape_entry*)ctx->malloc_fn(capacity*sizeof(tape_entry)))) return 0;
+		memcpy(e,tape->entries,tape->count*sizeof(tape_entry));
+		ctx->free_fn(tape->entries);
+		tape->entries=e;tape->capacity=capacity;
+	}
+	e=tape->entries+tape->count++;
+	e->type=type;e->next=tape->count;e->count=0;e->key=key;e->text=text;
+	return e;
+}
+
+cJSON_Tape *cJSON_TapeParse(char *value,cJSON_Context *context)
+{
+	parser ctx;cJSON_Tape *tape;const char *p,*start;int *open,depth=0,type;unsigned key=TAPE_NO_KEY;size_t length;
+	ctx.malloc_fn=(context && context->hooks.malloc_fn)?context->hooks.malloc_fn:cJSON_malloc;
+	ctx.free_fn=(context && context->hooks.free_fn)?context->hooks.free_fn:cJSON_free;
+	ctx.max_depth=(context && context->max_depth>0)?context->max_depth:CJSON_NESTING_LIMIT;
+	ctx.error=0;ctx.depth=0;ctx.insitu=1;
+	if (!value || (length=strlen(value))>=TAPE_NO_KEY) {if (context) context->error=value; else ep=value;return 0;}
+
+	tape=(cJSON_Tape*)ctx.malloc_fn(sizeof(cJSON_Tape));
+	open=(int*)ctx.malloc_fn(ctx.max_depth*sizeof(int));
+	if (!tape || !open) {if (tape) ctx.free_fn(tape);if (open) ctx.free_fn(open);return 0;}
+	tape->text=value;tape->count=0;tape->free_fn=ctx.free_fn;
+	tape->capacity=(int)(length/8<(size_t)INT_MAX/2?length/8:INT_MAX/2)+16;	/* Typical documents have a value every 8 to 16 bytes. */
+	if (!(tape->entries=(tape_entry*)ctx.malloc_fn(tape->capacity*sizeof(tape_entry)))) {ctx.free_fn(open);ctx.free_fn(tape);return 0;}
+
+	p=skip(value);
+	for (;;)
+	{
+		/* p is at a value. */
+		start=p;
+		if (!strncmp(p,"null",4))		type=cJSON_NULL,p+=4;
+		else if (!strncmp(p,"false",5))	type=cJSON_False,p+=5;
+		else if (!strncmp(p,"true",4))	type=cJSON_True,p+=4;
+		else if (*p=='\"')				type=cJSON_String,p=tape_parse_string(p,&ctx);
+		else if (*p=='-' || (*p>='0' && *p<='9'))	type=cJSON_Number,p=tape_skip_number(p);
+		else if (*p=='[' || *p=='{')	type=(*p=='[')?cJSON_Array:cJSON_Object,p++;
+		else {ctx.error=p;goto fail;}
+		if (!p) {ctx.error=value+length;goto fail;}	/* Unterminated string. */
+
+		if (depth>0) tape->entries[open[depth-1]].count++;
+		if (!tape_push(tape,&ctx,type,key,(unsigned)(start-value))) goto fail;
+		key=TAPE_NO_KEY;
+		if (type==cJSON_Array || type==cJSON_Object)
+		{
+			if (depth>=ctx.max_depth) {ctx.error=start;goto fail;}	/* Nested too deep. */
+			open[depth++]=tape->count-1;
+			p=skip(p);
+			if (type==cJSON_Array && *p!=']') continue;
+			if (type==cJSON_Object && *p!='}') goto parse_key;
+		}
+
+		/* After a value: close the containers which end here, then move on to the next value. */
+		for (;;)
+		{
+			p=skip(p);
+			if (depth==0) {ctx.free_fn(open);return tape;}
+			type=tape->entries[open[depth-1]].type;
+			if (*p==(type==cJSON_Array?']':'}')) {tape->entries[open[--depth]].next=tape->count;p++;continue;}
+			if (*p!=',') {ctx.error=p;goto fail;}
+			p=skip(p+1);
+			if (type==cJSON_Array) break;
+parse_key:
+			if (*p!='\"') {ctx.error=p;goto fail;}
+			key=(unsigned)(p-value);
+			if (!(p=tape_parse_string(p,&ctx))) {ctx.error=value+length;goto fail;}
+			p=skip(p);
+			if (*p!=':') {ctx.error=p;goto fail;}
+			p=skip(p+1);
+			break;
+		}
+	}
+fail:
+	ctx.free_fn(open);cJSON_TapeDelete(tape);
+	if (context) context->error=ctx.error; else ep=ctx.error;
+	return 0;
+}
+
+void cJSON_TapeDelete(cJSON_Tape *tape)	{if (tape) {tape->free_fn(tape->entries);tape->free_fn(tape);}}
+
+int cJSON_TapeType(cJSON_Tape *tape,int index)	{return tape->entries[index].type&255;}
+int cJSON_TapeSize(cJSON_Tape *tape,int index)	{return tape->entries[index].count;}
+
+const char *cJSON_TapeName(cJSON_Tape *tape,int index)
+{
+	tape_entry *e=tape->entries+index;
+	return (e->key==TAPE_NO_KEY)?0:tape->text+e->key+1;
+}
+
+int cJSON_TapeArrayItem(cJSON_Tape *tape,int index,int item)
+{
+	int c=index+1,end=tape->entries[index].next;
+	while (c<end && item>0) item--,c=tape->entries[c].next;
+	return (c<end)?c:-1;
+}
+
+int cJSON_TapeObjectItem(cJSON_Tape *tape,int index,const char *string)
+{
+	int c=index+1,end=tape->entries[index].next;const char *name;
+	if ((tape->entries[index].type&255)!=cJSON_Object || !string) return -1;
+	/* Keys are not hashed when indexing: compare the first character before the rest. */
+	for (;c<end;c=tape->entries[c].next)
+		if ((name=cJSON_TapeName(tape,c)) && *name==*string && !strcmp(name,string)) break;
+	return (c<end)?c:-1;
+}
+
+int cJSON_TapeChild(cJSON_Tape *tape,int index)			{return (index+1<tape->entries[index].next)?index+1:-1;}
+int cJSON_TapeNext(cJSON_Tape *tape,int index,int item)	{item=tape->entries[item].next;return (item<tape->entries[index].next)?item:-1;}
+
+int cJSON_TapeValue(cJSON_Tape *tape,int index,cJSON *item)
+{
+	tape_entry *e=tape->entries+index;
+	memset(item,0,sizeof(cJSON));
+	item->type=e->type&255;
+	if (item->type==cJSON_True) item->valueint=1;
+	else if (item->type==cJSON_String) item->valuestring=tape->text+e->text+1,item->type|=cJSON_ValueStringIsConst;
+	else if (item->type==cJSON_Number) cJSON_ParseNumber(item,tape->text+e->text);
+	return item->type&255;
+}
+
+/* Builds a tree of the value and its descendants; all of its strings point into the text. */
+cJSON *cJSON_TapeToTree(cJSON_Tape *tape,int index)
+{
+	cJSON *item=cJSON_New_Item(),*child;int c,end=tape->entries[index].next;
+	if (!item) return 0;
+	cJSON_TapeValue(tape,index,item);
+	for (c=index+1;c<end;c=tape->entries[c].next)
+	{
+		if (!(child=cJSON_TapeToTree(tape,c))) {cJSON_Delete(item);return 0;}
+		if (tape->entries[c].key!=TAPE_NO_KEY) set_key(child,(char*)cJSON_TapeName(tape,c)),child->type|=cJSON_StringIsConst;
+		add_tail(item,child);
+	}
+	return item;
+}
+
+//	XtraLife MODIFICATION	//
+/*
+ * Binary form (CBOR, RFC 8949). Numbers are encoded the way they print, so that both forms read back the same:
+ * integral values as integers, others as the smallest float type holding them exactly, NaN and infinities as null.
+ */
+#define CBOR_SELF_DESCRIBE 55799	/* Tag marking data as CBOR (d9 d9 f7), which text JSON never starts with. */
+
+static int cbor_head(printbuffer *p,int major,unsigned long long n)
+{
+	int len=(n<24)?0:(n<=0xFF)?1:(n<=0xFFFF)?2:(n<=0xFFFFFFFFULL)?4:8,i;
+	unsigned char *out=(unsigned char*)ensure(p,len+1);
+	if (!out) return 0;
+	out[0]=(unsigned char)((major<<5)|(len==0?(int)n:len==1?24:len==2?25:len==4?26:27));
+	for (i=len;i>0;i--,n>>=8) out[i]=(unsigned char)n;
+	p->offset+=len+1;
+	return 1;
+}
+
+static int cbor_integer(printbuffer *p,long long v)	{return (v<0)?cbor_head(p,1,(unsigned long long)-(v+1)):cbor_head(p,0,(unsigned long long)v);}
+
+static int cbor_number(cJSON *item,printbuffer *p)
+{
+	double d=item->valuedouble;float f=(float)d;unsigned char *out;unsigned long long bits;unsigned int bits32;int i,len;
+	if (item->type&cJSON_IsInt64)	return cbor_integer(p,item->valueint64);
+	if (d!=d || d-d!=0)				return cbor_head(p,7,22);
+	if (d==floor(d) && fabs(d)<9.2e18)	return cbor_integer(p,(long long)d);
+
+	if ((double)f==d)	{memcpy(&bits32,&f,4);bits=bits32;len=4;}
+	else				{memcpy(&bits,&d,8);len=8;}
+	if (!(out=(unsigned char*)ensure(p,len+1))) return 0;
+	out[0]=(len==4)?0xFA:0xFB;
+	for (i=len;i>0;i--,bits>>=8) out[i]=(unsigned char)bits;
+	p->offset+=len+1;
+	return 1;
+}
+
+static int cbor_string(const char *str,printbuffer *p)
+{
+	size_t len=str?strlen(str):0;char *out;
+	if (!cbor_head(p,3,len) || !(out=ensure(p,len))) return 0;
+	if (len) memcpy(out,str,len);
+	p->offset+=len;
+	return 1;
+}
+
+static int cbor_value(cJSON *item,printbuffer *p)
+{
+	cJSON *child;int count=0;
+	switch ((item->type)&255)
+	{
+		case cJSON_False:	return cbor_head(p,7,20);
+		case cJSON_True:	return cbor_head(p,7,21);
+		case cJSON_NULL:	return cbor_head(p,7,22);
+		case cJSON_Number:	return cbor_number(item,p);
+		case cJSON_String:	return cbor_string(item->valuestring,p);
+		case cJSON_Array:
+		case cJSON_Object:
+			for (child=item->child;child;child=child->next) count++;
+			if (!cbor_head(p,((item->type&255)==cJSON_Array)?4:5,count)) return 0;
+			for (child=item->child;child;child=child->next)
+				if (((item->type&255)==cJSON_Object && !cbor_string(child->string,p)) || !cbor_value(child,p)) return 0;
+			return 1;
+	}
+	return 0;
+}
+
+char *cJSON_PrintBinary(cJSON *item,size_t *length)
+{
+	printbuffer p;
+	p.buffer=0;p.length=0;p.offset=0;
+	if (!item || !cbor_head(&p,6,CBOR_SELF_DESCRIBE) || !cbor_value(item,&p)) {cJSON_free(p.buffer);return 0;}
+	*length=p.offset;
+	return p.buffer;
+}
+
+static int cbor_read_head(const unsigned char **p,const unsigned char *end,int *major,unsigned long long *n)
+{
+	int info,len;
+	if (*p>=end) return 0;
+	*major=**p>>5;info=**p&31;(*p)++;
+	if (info<24) {*n=(unsigned long long)info;return 1;}
+	if (info>27) return 0;	/* Indefinite lengths (never written) and reserved values. */
+	len=1<<(info-24);
+	if (end-*p<len) return 0;
+	for (*n=0;len>0;len--) *n=(*n<<8)|*(*p)++;
+	return 1;
+}
+
+static double cbor_half(unsigned h)
+{
+	int e=(h>>10)&31;double m=h&1023;
+	double d=(e==0)?ldexp(m,-24):(e!=31)?ldexp(m+1024,e-25):(m==0)?HUGE_VAL:HUGE_VAL-HUGE_VAL;
+	return (h&0x8000)?-d:d;
+}
+
+static const unsigned char *cbor_parse(cJSON *item,const unsigned char *p,const unsigned char *end,parser *ctx)
+{
+	const unsigned char *start=p;int major;unsigned long long n;
+	if (!cbor_read_head(&p,end,&major,&n)) {ctx->error=(const char*)start;return 0;}
+	switch (major)
+	{
+		case 0:
+		case 1:
+			set_number(item,major?-1.0-(double)n:(double)n);
+			if (n<=9223372036854775807ULL) {item->valueint64=major?-(long long)n-1:(long long)n;item->type|=cJSON_IsInt64;}	/* Exact, as when parsed from text. */
+			return p;
+		case 3:
+			if ((unsigned long long)(end-p)<n || !(item->valuestring=(char*)ctx->malloc_fn((size_t)n+1))) {ctx->error=(const char*)start;return 0;}
+			memcpy(item->valuestring,p,(size_t)n);item->valuestring[n]=0;
+			item->type=cJSON_String;
+			return p+n;
+		case 4:
+		case 5:
+		{
+			cJSON *child;
+			/* Every item takes at least a byte: don't trust a count which the data can't hold. */
+			if (ctx->depth>=ctx->max_depth || n>(unsigned long long)(end-p)) {ctx->error=(const char*)start;return 0;}
+			item->type=(major==4)?cJSON_Array:cJSON_Object;
+			ctx->depth++;
+			for (;n>0;n--)
+			{
+				if (!(child=parser_new_item(ctx))) return 0;
+				add_tail(item,child);
+				if (major==5)
+				{
+					const unsigned char *key=p;int keymajor;unsigned long long keylen;const char *interned=0;
+					if (cbor_read_head(&key,end,&keymajor,&keylen) && keymajor==3 && keylen<=(unsigned long long)(end-key))
+						interned=intern((const char*)key,(size_t)keylen);
+					start=p;
+					if (interned) p=key+keylen;
+					else
+					{
+						if (!(p=cbor_parse(child,p,end,ctx))) return 0;
+						if (child->type!=cJSON_String) {ctx->error=(const char*)start;return 0;}	/* Keys must be strings. */
+						set_key(child,child->valuestring);child->valuestring=0;
+					}
+					if (!(p=cbor_parse(child,p,end,ctx))) return 0;
+					if (interned) set_key(child,(char*)interned),child->type|=cJSON_StringIsConst;
+				}
+				else if (!(p=cbor_parse(child,p,end,ctx))) return 0;
+			}
+			ctx->depth--;
+			return p;
+		}
+		case 6:
+			if (n==CBOR_SELF_DESCRIBE) return cbor_parse(item,p,end,ctx);
+			break;
+		case 7:
+			switch (*start&31)
+			{
+				case 20:	item->type=cJSON_False;return p;
+				case 21:	item->type=cJSON_True;item->valueint=1;return p;
+				case 22:	item->type=cJSON_NULL;return p;
+				case 25:	set_number(item,cbor_half((unsigned)n));return p;
+				case 26:	{unsigned int bits=(unsigned int)n;float f;memcpy(&f,&bits,4);set_number(item,f);return p;}
+				case 27:	{double d;memcpy(&d,&n,8);set_number(item,d);return p;}
+			}
+			break;
+	}
+	ctx->error=(const char*)start;return 0;	/* Byte strings, other tags and simple values have no JSON equivalent. */
+}
+
+cJSON *cJSON_ParseBinary(const void *data,size_t length,cJSON_Context *context)
+{
+	parser ctx;cJSON *c;const unsigned char *p=(const unsigned char*)data;
+	ctx.malloc_fn=(context && context->hooks.malloc_fn)?context->hooks.malloc_fn:cJSON_malloc;
+	ctx.free_fn=(context && context->hooks.free_fn)?context->hooks.free_fn:cJSON_free;
+	ctx.max_depth=(context && context->max_depth>0)?context->max_depth:CJSON_NESTING_LIMIT;
+	ctx.error=0;ctx.depth=0;ctx.insitu=0;
+
+	c=parser_new_item(&ctx);
+	if (c && (!p || !cbor_parse(c,p,p+length,&ctx))) {delete_tree(c,ctx.free_fn);c=0;}
+	if (context) context->error=ctx.error; else ep=ctx.error;
+	return c;
+}
@@ -38,17 +38,24 @@ extern "C"
 #define cJSON_Object 6
 	
 #define cJSON_IsReference 256
+#define cJSON_StringIsConst 512		/* The item's name string is not owned (it points into an in-situ parse buffer). */
+#define cJSON_ValueStringIsConst 1024	/* The item's valuestring is not owned (it points into an in-situ parse buffer). */
+#define cJSON_IsInt64 2048			/* The number is an integer held exactly by valueint64 (valuedouble may have lost precision). */
 
 /* The cJSON structure: */
 typedef struct cJSON {
 	struct cJSON *next,*prev;	/* next/prev allow you to walk array/object chains. Alternatively, use GetArraySize/GetArrayItem/GetObjectItem */
+								/* The prev of the first item points to the last one, so that appending takes constant time. */
 	struct cJSON *child;		/* An array or object item will have a child pointer pointing to a chain of the items in the array/object. */
 
 	int type;					/* The type of the item, as above. */
+	int keylen;					/* Length of string, which cJSON keeps up to date with keyhash (both fill alignment padding). */
 
 	char *valuestring;			/* The item's string, if type==cJSON_String */
-	int valueint;				/* The item's number, if type==cJSON_Number */
+	int valueint;				/* The item's number, if type==cJSON_Number (saturated to the int range) */
+	unsigned int keyhash;		/* Hash of string, compared before its characters when looking up a key. */
 	double valuedouble;			/* The item's number, if type==cJSON_Number */
+	long long valueint64;		/* The item's number, if type==cJSON_Number (exact if cJSON_IsInt64 is set, else truncated) */
 
 	char *string;				/* The item's name string, if this item is the child of, or is in the list of subitems of an object. */
 } cJSON;
@@ -58,27 +65,53 @@ typedef struct cJSON_Hooks {
 	  void (*free_fn)(void *ptr);
 } cJSON_Hooks;
 
+/* Maximum nesting of arrays/objects accepted by the parser, unless a context says otherwise. */
+#ifndef CJSON_NESTING_LIMIT
+#define CJSON_NESTING_LIMIT 1000
+#endif
+
+/* Per-call parser settings and result, which make parsing reentrant. */
+typedef struct cJSON_Context {
+	cJSON_Hooks hooks;			/* Allocator for the parsed tree (zeroed: the one set by cJSON_InitHooks). Free it with cJSON_DeleteWithHooks. */
+	int max_depth;				/* Maximum nesting of arrays/objects, 0 for CJSON_NESTING_LIMIT. */
+	const char *error;			/* Out: position in the input where parsing failed, or 0 on success. */
+} cJSON_Context;
+
 /* Supply malloc, realloc and free functions to cJSON */
 void cJSON_InitHooks(cJSON_Hooks* hooks);
 
 
 /* Supply a block of JSON, and this returns a cJSON object you can interrogate. Call cJSON_Delete when finished. */
 cJSON *cJSON_Parse(const char *value);
+/* Same as cJSON_Parse, but unescapes strings in place inside the (NUL-terminated, writable) value buffer instead of
+   allocating a copy for each of them. The buffer is destroyed in the process and must outlive the returned tree. */
+cJSON *cJSON_ParseInSitu(char *value);
+/* Reentrant versions of the above: errors are reported in the context (context may be NULL), nothing global is touched. */
+cJSON *cJSON_ParseWithContext(const char *value,cJSON_Context *context);
+cJSON *cJSON_ParseInSituWithContext(char *value,cJSON_Context *context);
+/* Parse the number at value into the number fields of item (which may live on the stack). Returns the end of the number, or 0. */
+const char *cJSON_ParseNumber(cJSON *item,const char *value);
 /* Render a cJSON entity to text for transfer/storage. Free the char* when finished. */
 char  *cJSON_Print(cJSON *item);
 /* Render a cJSON entity to text for transfer/storage without any formatting. Free the char* when finished. */
 char  *cJSON_PrintUnformatted(cJSON *item);
+/* Render a cJSON entity into *buffer (a cJSON_malloc'd block of *capacity bytes, or NULL), growing it as needed so that it
+   can be reused across calls. Returns *buffer, or 0 on failure, in which case the buffer still belongs to the caller. */
+char  *cJSON_PrintIntoBuffer(cJSON *item,char **buffer,size_t *capacity,int fmt);
 /* Delete a cJSON entity and all subentities. */
 void   cJSON_Delete(cJSON *c);
+/* Delete a tree that was parsed with the given context hooks. */
+void   cJSON_DeleteWithHooks(cJSON *c,cJSON_Hooks *hooks);
 
 /* Returns the number of items in an array (or object). */
 int	  cJSON_GetArraySize(cJSON *array);
 /* Retrieve item number "item" from array "array". Returns NULL if unsuccessful. */
 cJSON *cJSON_GetArrayItem(cJSON *array,int item);
-/* Get item "string" from object. Case insensitive. */
+/* Get item "string" from object. Case sensitive. */
 cJSON *cJSON_GetObjectItem(cJSON *object,const char *string);
 
-/* For analysing failed parses. This returns a pointer to the parse error. You'll probably need to look a few chars back to make sense of it. Defined when cJSON_Parse() returns 0. 0 when cJSON_Parse() succeeds. */
+/* For analysing failed parses. This returns a pointer to the parse error. You'll probably need to look a few chars back to make sense of it. Defined when cJSON_Parse() returns 0. 0 when cJSON_Parse() succeeds.
+   Shared by all threads: use cJSON_ParseWithContext when parsing concurrently. */
 const char *cJSON_GetErrorPtr(void);
 	
 /* These calls create a cJSON item of the appropriate type. */
@@ -87,6 +120,7 @@ cJSON *cJSON_CreateTrue(void);
 cJSON *cJSON_CreateFalse(void);
 cJSON *cJSON_CreateBool(int b);
 cJSON *cJSON_CreateNumber(double num);
+cJSON *cJSON_CreateInt64(long long num);
 cJSON *cJSON_CreateString(const char *string);
 cJSON *cJSON_CreateArray(void);
 cJSON *cJSON_CreateObject(void);
@@ -97,8 +131,16 @@ cJSON *cJSON_CreateFloatArray(float *numbers,int count);
 cJSON *cJSON_CreateDoubleArray(double *numbers,int count);
 cJSON *cJSON_CreateStringArray(const char **strings,int count);
 
+/* Duplicate a cJSON item (and its children if recurse is set). The copy is independent and, not being part of any
+   object, has no name: free it with cJSON_Delete. */
+cJSON *cJSON_Duplicate(cJSON *item,int recurse);
+/* Deep comparison: numbers by value (exactly when both are 64-bit integers), object keys in any order. */
+int cJSON_Compare(cJSON *a,cJSON *b);
+
 /* Append item to the specified array/object. */
 void cJSON_AddItemToArray(cJSON *array, cJSON *item);
+/* Moves all the items of from (an array or object, left empty) to the end of array, in constant time. */
+void cJSON_AddItemsToArray(cJSON *array, cJSON *from);
 void	cJSON_AddItemToObject(cJSON *object,const char *string,cJSON *item);
 /* Append reference to item to the specified array/object. Use this when you want to add an existing cJSON to a new cJSON, but don't want to corrupt your existing cJSON. */
 void cJSON_AddItemReferenceToArray(cJSON *array, cJSON *item);
@@ -111,9 +153,38 @@ cJSON *cJSON_DetachItemFromObject(cJSON *object,const char *string);
 void   cJSON_DeleteItemFromObject(cJSON *object,const char *string);
 	
 /* Update array items. */
+void cJSON_InsertItemInArray(cJSON *array,int which,cJSON *newitem);	/* Shifts pre-existing items to the right; appends if which is past the end. */
 void cJSON_ReplaceItemInArray(cJSON *array,int which,cJSON *newitem);
 void cJSON_ReplaceItemInObject(cJSON *object,const char *string,cJSON *newitem);
 
+/* Binary (CBOR, RFC 8949) form of a cJSON entity, for storage: more compact, and read back without parsing text. Returns
+   a cJSON_malloc'd buffer of *length bytes (starting with the CBOR self-describe tag d9 d9 f7), or 0 on failure. */
+char  *cJSON_PrintBinary(cJSON *item,size_t *length);
+/* Builds a tree from CBOR data, such as produced by cJSON_PrintBinary. Types that JSON can't represent fail. */
+cJSON *cJSON_ParseBinary(const void *data,size_t length,cJSON_Context *context);
+
+/* Lazy parsing: cJSON_TapeParse only indexes the structure of value (a NUL-terminated, writable buffer which must outlive
+   the tape), unescaping its strings in place without building any tree. Values are designated by their index in the tape,
+   the root being 0. Reading a tape never writes to it or to the buffer, so it may be read from several threads at once. */
+typedef struct cJSON_Tape cJSON_Tape;
+cJSON_Tape *cJSON_TapeParse(char *value,cJSON_Context *context);
+void   cJSON_TapeDelete(cJSON_Tape *tape);
+/* Type of a value (as above, without flags), and number of items if it is an array or object. */
+int    cJSON_TapeType(cJSON_Tape *tape,int index);
+int    cJSON_TapeSize(cJSON_Tape *tape,int index);
+/* Index of item number "item" of an array (or object), or of item "string" of an object (case sensitive); -1 if none. */
+int    cJSON_TapeArrayItem(cJSON_Tape *tape,int index,int item);
+int    cJSON_TapeObjectItem(cJSON_Tape *tape,int index,const char *string);
+/* Walking the items of an array or object: the first one, then the one following item; -1 when there are no more. */
+int    cJSON_TapeChild(cJSON_Tape *tape,int index);
+int    cJSON_TapeNext(cJSON_Tape *tape,int index,int item);
+/* Key of a value inside an object, NULL otherwise. */
+const char *cJSON_TapeName(cJSON_Tape *tape,int index);
+/* Decodes a value into item (which may live on the stack; children are not filled). Returns its type. */
+int    cJSON_TapeValue(cJSON_Tape *tape,int index,cJSON *item);
+/* Builds a regular tree of a value, whose strings point into the buffer. Free it with cJSON_Delete, before the buffer. */
+cJSON *cJSON_TapeToTree(cJSON_Tape *tape,int index);
+
 #define cJSON_AddNullToObject(object,name)	cJSON_AddItemToObject(object, name, cJSON_CreateNull())
 #define cJSON_AddTrueToObject(object,name)	cJSON_AddItemToObject(object, name, cJSON_CreateTrue())
 #define cJSON_AddFalseToObject(object,name)		cJSON_AddItemToObject(object, name, cJSON_CreateFalse())
@@ -6,6 +6,8 @@
 //  Copyright 2011 Clan of the Cloud. All rights reserved.
 //
 
+#include <algorithm>
+#include <chrono>
 #include <list>
 
 #include "include/CHJSON.h"
@@ -51,6 +53,16 @@ namespace XtraLife {
 		int 	code;
 		bool    binary;
 		bool	obsolete;
+
+		// Streamed responses (see CHttpRequest::SetStreamHandler and SetDataHandler)
+		CURL	*handle;
+		Helpers::CJsonStreamHandler *streamHandler;
+		Helpers::CJsonReader *streamReader;
+		CHttpDataHandler *dataHandler;
+		bool	streamDecided, streaming, streamStopped;
+
+		// Header list passed to curl, pointing to the lines of the request (plus the content type); no allocation
+		struct curl_slist headers[CHttpRequest::MaxHeaders + 1];
 	} IOBuf;
 
 
@@ -88,8 +100,16 @@ namespace XtraLife {
 		void EnqueueRequest(CHttpRequest *request);
 		/**
 		 * Blocking method, meant to be called internally.
+		 * @param bodyBuffer storage the JSON body is serialized into; keep it across calls so that its memory gets reused.
 		 */
-		static CCloudResult *PerformRequest(CURL *ch, CHttpRequest *req);
+		static CCloudResult *PerformRequest(CURL *ch, CHttpRequest *req, cstring &bodyBuffer);
+		/**
+		 * The two halves of PerformRequest, for requests performed by a CHttpMultiplexer: sets up ch to perform req, then
+		 * builds the result once curl is done with it. The caller frees b afterwards.
+		 * @return a number identifying the request in the logs
+		 */
+		static long PrepareRequest(CURL *ch, CHttpRequest *req, cstring &bodyBuffer, IOBuf *b);
+		static CCloudResult *MakeResult(CURL *ch, CHttpRequest *req, IOBuf *b, CURLcode retCode, long number);
 		static bool ShouldChangeLoadBalancer(const CCloudResult *result);
 		static bool ShouldRetryRequest(CHttpRequest *request, const CCloudResult *result);
 		void Terminate();
@@ -161,7 +181,32 @@ namespace XtraLife {
 		return QueryParam(name, buffer);
 	}
 
-	CHttpRequest::CHttpRequest(const char *url) : url(url), method(NULL), callback(NULL), connectTimeout(g_defaultConnectTimeout), timeout(g_defaultTimeout), retryPolicy(NonpermanentErrors), binaryUpload(false), binaryDownload(false), cancellationFlag(NULL) {}
+	CHttpRequest::CHttpRequest(const char *url) : url(url), method(NULL), headerCount(0), callback(NULL), connectTimeout(g_defaultConnectTimeout), timeout(g_defaultTimeout), retryPolicy(NonpermanentErrors), binaryUpload(false), binaryDownload(false), cancellationFlag(NULL) {}
+
+	void CHttpRequest::SetHeader(const char *name, const char *value) {
+		size_t nameLength = strlen(name);
+		int i = 0;
+		while (i < headerCount && (strncmp(headers[i], name, nameLength) || headers[i].c_str()[nameLength] != ':')) { i++; }
+		if (i == MaxHeaders) {
+			CONSOLE_ERROR("Too many headers on request to %s, dropping %s\n", url.c_str(), name);
+			return;
+		}
+		if (i == headerCount) { headerCount++; }
+		csprintf(headers[i], "%s: %s", name, value ? value : "");
+	}
+}
+
+XtraLife::CHttpHeaders::CHttpHeaders() : mList(NULL) {
+}
+
+XtraLife::CHttpHeaders::~CHttpHeaders() {
+	curl_slist_free_all(mList);
+}
+
+void XtraLife::CHttpHeaders::Add(const char *name, const char *value) {
+	char buffer[1024];
+	safe::sprintf(buffer, "%s: %s", name, value ? value : "");
+	mList = curl_slist_append(mList, buffer);
 }
 
 #define CAPACITY 4096
@@ -176,6 +221,7 @@ XtraLife::IOBuf *XtraLife::curl_iobuf_new() {
 	
 	bf->capacity = CAPACITY;
 	bf->buffer = (char *) malloc(bf->capacity);
+	bf->buffer[0] = 0;	// in case no data is ever received
 	bf->binary = false;
 	return bf;
 }
@@ -213,6 +259,37 @@ static size_t writefunc(void * ptr, size_t size, size_t nmemb, void * stream) {
 	XtraLife::IOBuf* rec = (XtraLife::IOBuf*) stream;
 	size_t bytes = size * nmemb;
 	
+	// Successful responses go to the stream handler if there is one (errors are buffered as usual, for the result)
+	if ((rec->streamHandler || rec->dataHandler) && !rec->streamDecided) {
+		long httpCode = 0;
+		curl_easy_getinfo(rec->handle, CURLINFO_RESPONSE_CODE, &httpCode);
+		rec->streamDecided = true;
+		rec->streaming = httpCode >= 200 && httpCode < 300;
+		if (rec->streaming && rec->dataHandler) {
+			char *contentType = NULL;
+			curl_easy_getinfo(rec->handle, CURLINFO_CONTENT_TYPE, &contentType);
+			rec->streaming = rec->dataHandler->OnBegin(contentType ? contentType : "");
+		} else if (rec->streaming) {
+			rec->streamReader->Reset();
+			rec->streamHandler->OnBegin(*rec->streamReader);
+		}
+	}
+	if (rec->streaming) {
+		bool more;
+		if (rec->dataHandler) {
+			more = rec->dataHandler->OnData((const char *) ptr, bytes);
+		} else {
+			rec->streamReader->Feed((const char *) ptr, bytes);
+			more = rec->streamHandler->OnData(*rec->streamReader);
+		}
+		if (!more) {
+			// Returning less than received aborts the transfer
+			rec->streamStopped = true;
+			return 0;
+		}
+		return bytes;
+	}
+
 	// Check the buffer size
 	if ((rec->size + bytes) >= rec->capacity) { // == for the trailing '0'
 		// Reallocate the buffer
@@ -272,7 +349,7 @@ static size_t header(char *ptr, size_t size, size_t nmemb, void *stream) {
 }
 
 // Abort process ASAP when the lib is de-inited
-static int progresscallback(bool *cancellationFlag, double dltotal, double dlnow, double ultotal, double ulnow) {
+static int progresscallback(std::atomic<bool> *cancellationFlag, double dltotal, double dlnow, double ultotal, double ulnow) {
 	if (!XtraLife::g_httpInited || (cancellationFlag && *cancellationFlag)) { return -1; }
 	return 0;
 }
@@ -311,7 +388,15 @@ XtraLife::RequestDispatcher * XtraLife::RequestDispatcher::Instance() {
 	return requestDispatcherInstance ? requestDispatcherInstance : (requestDispatcherInstance <<= new RequestDispatcher);
 }
 
-CCloudResult *XtraLife::RequestDispatcher::PerformRequest(CURL *ch, CHttpRequest *req) {
+CCloudResult *XtraLife::RequestDispatcher::PerformRequest(CURL *ch, CHttpRequest *req, cstring &bodyBuffer) {
+	IOBuf *b = curl_iobuf_new();
+	long gcount = PrepareRequest(ch, req, bodyBuffer, b);
+	CCloudResult *result = MakeResult(ch, req, b, curl_easy_perform(ch), gcount);
+	curl_iobuf_free(b);
+	return result;
+}
+
+long XtraLife::RequestDispatcher::PrepareRequest(CURL *ch, CHttpRequest *req, cstring &bodyBuffer, IOBuf *b) {
 	char fullurl[1024], lb_id_str[16], buffer[1024];
 	static long g_reqCount = 0;
 	long gcount = ++g_reqCount;
@@ -344,21 +429,30 @@ CCloudResult *XtraLife::RequestDispatcher::PerformRequest(CURL *ch, CHttpRequest
 		}
 	}
 
-	IOBuf *b = curl_iobuf_new();
+	b->handle = ch;
+	b->streamHandler = req->streamHandler;
+	b->streamReader = req->streamReader;
+	b->dataHandler = req->dataHandler;
 	curl_easy_reset(ch);
-	struct curl_slist *slist = NULL;
 
-	// Has JSON body?
-	cstring jsonBody;
+	// Has JSON body? (serialized in the caller's buffer, which is reused from one request to the next)
+	const char *jsonBody = NULL;
+	int headerCount = 0;
 	if (req->json) {
-		jsonBody = req->json->print();
-		slist = curl_slist_append(slist, "Content-Type: application/json");
+		jsonBody = req->json->print(bodyBuffer);
+		b->headers[headerCount++].data = (char*) "Content-Type: application/json";
 	}
 	
 	// Plus additional headers defined in the request
-	for (std::map<const char*, cstring>::iterator it = req->headers.begin(); it != req->headers.end(); ++it) {
-		safe::sprintf(buffer, "%s: %s", it->first, it->second.c_str());
-		slist = curl_slist_append(slist, buffer);
+	for (int i = 0; i < req->headerCount; i++) {
+		b->headers[headerCount++].data = req->headers[i].c_str();
+	}
+	// The shared headers come last, linked rather than copied (curl only reads the list)
+	struct curl_slist *slist = req->sharedHeaders ? req->sharedHeaders->mList : NULL;
+	while (headerCount > 0) {
+		headerCount--;
+		b->headers[headerCount].next = slist;
+		slist = &b->headers[headerCount];
 	}
 	
 	print_current_time(buffer);
@@ -381,7 +475,7 @@ CCloudResult *XtraLife::RequestDispatcher::PerformRequest(CURL *ch, CHttpRequest
 	// Post if JSON body is provided
 	if (jsonBody) {
 		curl_easy_setopt(ch, CURLOPT_POST, 1);
-		curl_easy_setopt(ch, CURLOPT_POSTFIELDS, jsonBody.c_str());
+		curl_easy_setopt(ch, CURLOPT_POSTFIELDS, jsonBody);
 	} else if (req->binaryUpload) {
 		curl_easy_setopt(ch, CURLOPT_POST, 1);
 		curl_easy_setopt(ch, CURLOPT_READDATA, req );
@@ -402,11 +496,23 @@ CCloudResult *XtraLife::RequestDispatcher::PerformRequest(CURL *ch, CHttpRequest
 	if (g_httpVerbose) {
 		curl_easy_setopt(ch, CURLOPT_VERBOSE, 1L);
 		if (jsonBody) {
-			CONSOLE_VERBOSE("JSON body: %s\n", jsonBody.c_str());
+			CONSOLE_VERBOSE("JSON body: %s\n", jsonBody);
 		}
 	}
 
-	CURLcode retCode = curl_easy_perform(ch);
+	return gcount;
+}
+
+CCloudResult *XtraLife::RequestDispatcher::MakeResult(CURL *ch, CHttpRequest *req, IOBuf *b, CURLcode retCode, long gcount) {
+	if (b->streaming) {
+		if (b->streamStopped && retCode == CURLE_WRITE_ERROR) {
+			// Stopped on purpose by the handler
+			retCode = CURLE_OK;
+		} else if (retCode == CURLE_OK && req->streamHandler) {
+			req->streamReader->Finish();
+			req->streamHandler->OnData(*req->streamReader);
+		}
+	}
 
 	CONSOLE_VERBOSE("response URL[%ld] %d: '%s':\n", gcount , retCode, b->result);
 	if (g_httpVerbose) {
@@ -430,12 +536,17 @@ CCloudResult *XtraLife::RequestDispatcher::PerformRequest(CURL *ch, CHttpRequest
 				result = new CCloudResult(enNoErr, resjson);
 				result->SetBinary(b->buffer, b->size);
 				b->buffer = NULL; // will be released by CCloudResult...
+			} else if (b->streaming) {
+				// The body has already been handed to the stream handler
+				result = new CCloudResult(enNoErr, new CHJSON());
 			} else if (req->binaryUpload) {
 				CHJSON *resjson = new CHJSON();
 				resjson->Put("url", req->url);
 				result = new CCloudResult(enNoErr, resjson);
 			} else {
-				CHJSON *resjson = CHJSON::parse(b->buffer);
+				// Only index the response: its values are decoded inside the receive buffer, now owned by the JSON, as they are read
+				CHJSON *resjson = CHJSON::parseLazy(b->buffer);
+				b->buffer = NULL;
 				if (resjson == NULL) resjson = new CHJSON();
 				result = new CCloudResult(enNoErr, resjson);
 			}
@@ -458,11 +569,7 @@ CCloudResult *XtraLife::RequestDispatcher::PerformRequest(CURL *ch, CHttpRequest
 		result->SetCurlErrorCode(retCode);
 		result->SetErrorCode(XtraLife::enNetworkError);
 	}
-
-	curl_slist_free_all(slist);
-//	curl_easy_cleanup(ch);
-	curl_iobuf_free(b);
-	return (CCloudResult*) result;
+	return result;
 }
 
 void XtraLife::RequestDispatcher::Run() {
@@ -477,6 +584,7 @@ void XtraLife::RequestDispatcher::Run() {
 	CONSOLE_VERBOSE("Starting HTTP thread %d\n", threadId);
 
 	CURL *ch = curl_easy_init();
+	cstring bodyBuffer;
 
 	while (mActive) {
 		// Upon custom error delegate, process requests anyway
@@ -486,7 +594,7 @@ void XtraLife::RequestDispatcher::Run() {
 			CHttpRequest *req = pendingRequests->front();
 			// Allow other threads to push additional requests while we handle them
 			pendingRequests = mRequestGuard.UnlockVar();
-			CCloudResult *result = PerformRequest(ch, req);
+			CCloudResult *result = PerformRequest(ch, req, bodyBuffer);
 			retryIn = 0;
 
 			// If the request failed due to a recoverable error, pause for a while
@@ -598,7 +706,9 @@ void XtraLife::RequestDispatcher::Terminate() {
 		mActive = false;
 		// Mark it as inactive
 		g_activeRequestDispatcherThreadId++;
+		mRequestGuard.LockVar();
 		mRequestGuard.SignalAll();
+		mRequestGuard.UnlockVar();
 	}
 	Join();
 	requestDispatcherInstance <<= NULL;
@@ -606,7 +716,9 @@ void XtraLife::RequestDispatcher::Terminate() {
 
 void XtraLife::RequestDispatcher::UnblockThread() {
 	if (mAlreadyStarted) {
+		mRequestGuard.LockVar();
 		mRequestGuard.SignalAll();
+		mRequestGuard.UnlockVar();
 	}
 }
 
@@ -638,9 +750,10 @@ CCloudResult *XtraLife::http_perform_synchronous(CHttpRequest *request) {
 	static bool failedLastTime = false;
 	size_t currentDelayId = failedLastTime ? numberof(RETRY_DELAYS_MILLISEC) - 1 : 0;
 	CURL *ch = curl_easy_init();
+	cstring bodyBuffer;
 
 	while (true) {
-		CCloudResult *result = RequestDispatcher::PerformRequest(ch, request);
+		CCloudResult *result = RequestDispatcher::PerformRequest(ch, request, bodyBuffer);
 		if (RequestDispatcher::ShouldRetryRequest(request, result)) {
 			// Each delay is tested twice on a different load-balancer
 			if (needNewBalancer)  {
@@ -654,7 +767,9 @@ CCloudResult *XtraLife::http_perform_synchronous(CHttpRequest *request) {
 			// Check that we didn't fail too many times
 			if (currentDelayId < numberof(RETRY_DELAYS_MILLISEC)) {
 				CONSOLE_VERBOSE("Request failed, will retry in %dms\n", RETRY_DELAYS_MILLISEC[currentDelayId]);
+				g_synchronousCancelVariable->LockVar();
 				g_synchronousCancelVariable->Wait(RETRY_DELAYS_MILLISEC[currentDelayId]);
+				g_synchronousCancelVariable->UnlockVar();
 			} else {
 				CONSOLE_VERBOSE("Giving up request to %s, failed to many times\n", request->url.c_str());
 				failedLastTime = true;
@@ -673,6 +788,181 @@ CCloudResult *XtraLife::http_perform_synchronous(CHttpRequest *request) {
 	}
 }
 
+//////////////////////////// Multiplexer ////////////////////////////
+// A request added to a CHttpMultiplexer, either running or waiting to be retried
+struct XtraLife::CHttpMultiplexer::Transfer {
+	CURL *handle;
+	CHttpRequest *request;
+	IOBuf *buf;
+	cstring body;
+	void *cookie;
+	CCloudResult *result;
+	long number;
+	// Retry state, as in http_perform_synchronous
+	size_t currentDelayId;
+	bool needNewBalancer, waitingRetry;
+	std::chrono::steady_clock::time_point retryAt;
+};
+
+XtraLife::CHttpMultiplexer::CHttpMultiplexer() : mMulti(curl_multi_init()), mFailedLastTime(false), mWakeupPending(false) {
+}
+
+XtraLife::CHttpMultiplexer::~CHttpMultiplexer() {
+	while (!mTransfers.empty()) {
+		Abort(mTransfers.back()->cookie);
+	}
+	for (size_t i = 0; i < mCompleted.size(); i++) {
+		delete mCompleted[i]->result;
+		delete mCompleted[i];
+	}
+	curl_multi_cleanup((CURLM*) mMulti);
+}
+
+void XtraLife::CHttpMultiplexer::Add(CHttpRequest *request, void *cookie) {
+	Transfer *t = new Transfer;
+	t->handle = curl_easy_init();
+	t->request = request;
+	t->buf = NULL;
+	t->cookie = cookie;
+	t->result = NULL;
+	t->currentDelayId = mFailedLastTime ? numberof(RETRY_DELAYS_MILLISEC) - 1 : 0;
+	t->needNewBalancer = true;
+	t->waitingRetry = false;
+	mTransfers.push_back(t);
+	Start(t);
+}
+
+void XtraLife::CHttpMultiplexer::Abort(void *cookie) {
+	for (size_t i = 0; i < mTransfers.size(); i++) {
+		Transfer *t = mTransfers[i];
+		if (t->cookie == cookie) {
+			Finish(t);
+			curl_easy_cleanup(t->handle);
+			delete t->request;
+			delete t;
+			mTransfers.erase(mTransfers.begin() + i);
+			return;
+		}
+	}
+}
+
+void XtraLife::CHttpMultiplexer::Start(Transfer *t) {
+	t->buf = curl_iobuf_new();
+	t->number = RequestDispatcher::PrepareRequest(t->handle, t->request, t->body, t->buf);
+	curl_easy_setopt(t->handle, CURLOPT_PRIVATE, t);
+	curl_multi_add_handle((CURLM*) mMulti, t->handle);
+	t->waitingRetry = false;
+}
+
+void XtraLife::CHttpMultiplexer::Finish(Transfer *t) {
+	if (!t->buf) { return; }
+	curl_multi_remove_handle((CURLM*) mMulti, t->handle);
+	curl_iobuf_free(t->buf);
+	t->buf = NULL;
+}
+
+void XtraLife::CHttpMultiplexer::Perform(int timeoutMs) {
+	CURLM *multi = (CURLM*) mMulti;
+	std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+	int running = 0;
+
+	// Restart the requests whose retry delay has elapsed, and wake up in time for the next ones
+	for (size_t i = 0; i < mTransfers.size(); i++) {
+		Transfer *t = mTransfers[i];
+		if (!t->waitingRetry) {
+			continue;
+		} else if (t->retryAt <= now) {
+			Start(t);
+		} else {
+			int delay = (int) std::chrono::duration_cast<std::chrono::milliseconds>(t->retryAt - now).count() + 1;
+			if (delay < timeoutMs) { timeoutMs = delay; }
+		}
+	}
+
+	curl_multi_perform(multi, &running);
+#if LIBCURL_VERSION_NUM >= 0x074400
+	curl_multi_poll(multi, NULL, 0, timeoutMs, NULL);
+#else
+	if (running > 0) {
+		// curl_multi_wait can not be interrupted, so Wakeup may take up to that long
+		curl_multi_wait(multi, NULL, 0, timeoutMs < 100 ? timeoutMs : 100, NULL);
+	} else if (timeoutMs > 0) {
+		mWakeupVar.LockVar();
+		if (!mWakeupPending) { mWakeupVar.Wait(timeoutMs); }
+		mWakeupVar.UnlockVar();
+	}
+	mWakeupVar.LockVar();
+	mWakeupPending = false;
+	mWakeupVar.UnlockVar();
+#endif
+	curl_multi_perform(multi, &running);
+
+	// Collect the finished transfers
+	CURLMsg *msg;
+	int remaining;
+	now = std::chrono::steady_clock::now();
+	while ((msg = curl_multi_info_read(multi, &remaining))) {
+		if (msg->msg != CURLMSG_DONE) { continue; }
+		Transfer *t = NULL;
+		curl_easy_getinfo(msg->easy_handle, CURLINFO_PRIVATE, (char**) &t);
+		CCloudResult *result = RequestDispatcher::MakeResult(t->handle, t->request, t->buf, msg->data.result, t->number);
+		Finish(t);
+
+		if (RequestDispatcher::ShouldRetryRequest(t->request, result)) {
+			// Each delay is tested twice on a different load-balancer
+			if (t->needNewBalancer)  {
+				RequestDispatcher::mCredentials.needsChooseNewLoadBalancer = true;
+				t->needNewBalancer = false;
+			} else {
+				t->currentDelayId++;
+				t->needNewBalancer = true;
+			}
+
+			if (t->currentDelayId < numberof(RETRY_DELAYS_MILLISEC)) {
+				CONSOLE_VERBOSE("Request failed, will retry in %dms\n", RETRY_DELAYS_MILLISEC[t->currentDelayId]);
+				t->waitingRetry = true;
+				t->retryAt = now + std::chrono::milliseconds(RETRY_DELAYS_MILLISEC[t->currentDelayId]);
+				delete result;
+				continue;
+			}
+			CONSOLE_VERBOSE("Giving up request to %s, failed to many times\n", t->request->url.c_str());
+			mFailedLastTime = true;
+		} else {
+			if (RequestDispatcher::ShouldChangeLoadBalancer(result)) {
+				RequestDispatcher::mCredentials.needsChooseNewLoadBalancer = true;
+			}
+			mFailedLastTime = false;
+		}
+
+		t->result = result;
+		curl_easy_cleanup(t->handle);
+		delete t->request;
+		mTransfers.erase(std::find(mTransfers.begin(), mTransfers.end(), t));
+		mCompleted.push_back(t);
+	}
+}
+
+CCloudResult *XtraLife::CHttpMultiplexer::Completed(void *&cookie) {
+	if (mCompleted.empty()) { return NULL; }
+	Transfer *t = mCompleted.front();
+	CCloudResult *result = t->result;
+	cookie = t->cookie;
+	mCompleted.erase(mCompleted.begin());
+	delete t;
+	return result;
+}
+
+void XtraLife::CHttpMultiplexer::Wakeup() {
+#if LIBCURL_VERSION_NUM >= 0x074400
+	curl_multi_wakeup((CURLM*) mMulti);
+#else
+	mWakeupVar.LockVar();
+	mWakeupPending = true;
+	mWakeupVar.SignalAll();
+	mWakeupVar.UnlockVar();
+#endif
+}
+
 void XtraLife::http_terminate() {
 	g_httpInited = false;
 	RequestDispatcher::Instance()->Terminate();
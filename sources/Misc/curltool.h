@@ -9,10 +9,14 @@
 #ifndef curltool_h
 #define curltool_h
 
-#include <map>
+#include <atomic>
+#include <vector>
 
 #include "Core/CCallback.h"
 #include "Misc/helpers.h"
+#include "include/CJsonReader.h"
+
+struct curl_slist;
 
 namespace XtraLife {
     namespace Helpers {
@@ -25,7 +29,40 @@ namespace XtraLife {
 	class CCloudResult;
 
     extern char g_curlUserAgent[128];
+
+	/**
+	 * Receives the raw body of a successful response while it downloads (see CHttpRequest::SetDataHandler).
+	 */
+	struct CHttpDataHandler {
+		virtual ~CHttpDataHandler() {}
+		/**
+		 * Called on the HTTP thread when a successful response starts, including again if the request is retried.
+		 * @param contentType content type of the response, empty if unknown
+		 * @return whether to stream this response; if not, it is parsed and delivered through the result as usual
+		 */
+		virtual bool OnBegin(const char *contentType) = 0;
+		/**
+		 * Called on the HTTP thread with each piece of the body.
+		 * @return false to stop the download; the request then completes normally
+		 */
+		virtual bool OnData(const char *data, size_t length) = 0;
+	};
     
+	/**
+	 * Headers sent as is by many requests, such as the credentials, formatted once for curl. Fill it with Add, then share
+	 * it with CHttpRequest::SetSharedHeaders; it must not be modified anymore from then on.
+	 */
+	class CHttpHeaders: public Helpers::CRefClass {
+	public:
+		CHttpHeaders();
+		~CHttpHeaders();
+		void Add(const char *name, const char *value);
+
+	private:
+		struct curl_slist *mList;
+		friend class RequestDispatcher;
+	};
+
 	/**
 	 * Description of an HTTP request to be performed.
 	 */
@@ -46,6 +83,11 @@ namespace XtraLife {
 		 * @param json JSON object representing the body to send. This object will be owned by the request, so you need to pass a new instance and not delete it!
 		 */
 		void SetBody(Helpers::CHJSON *json) { this->json <<= json; }
+		/**
+		 * Sets a JSON built locally as the body, by moving its contents rather than copying them.
+		 * @param json JSON object representing the body to send, left empty.
+		 */
+		void SetBody(Helpers::CHJSON &&json) { this->json <<= new Helpers::CHJSON(std::move(json)); }
 		/**
 		 * Sets the body of the HTTP request.
 		 * @param ptr Pointer to binary data
@@ -57,11 +99,16 @@ namespace XtraLife {
 		 */
 		void SetCallback(CCallback *callback) { this->callback = callback; }
 		/**
-		 * Sets a header on the request.
-		 * @param name the header name (expected to be a constant literal as it is not copied)
+		 * Sets a header on the request, replacing any previous value. At most MaxHeaders may be set.
+		 * @param name the header name
 		 * @param value the header value (copied)
 		 */
-		void SetHeader(const char *name, const char *value) { headers[name] = value; }
+		void SetHeader(const char *name, const char *value);
+		/**
+		 * Sends a prebuilt set of headers along with those set with SetHeader (which should not set the same ones).
+		 * @param headers the headers, retained until the request is freed
+		 */
+		void SetSharedHeaders(CHttpHeaders *headers) { sharedHeaders = Helpers::autoref<CHttpHeaders>(headers); }
 		/**
 		 * Sets the method for the request.
 		 * @param method either "GET", "POST", "PUT" or "DELETE" (expected to be a constant literal as it is not copied)
@@ -85,7 +132,21 @@ namespace XtraLife {
 		/**
 		 * @param setToTrueFromAnyThreadToAbort sets the cancellation flag for this request
 		 */
-		void SetCancellationFlag(bool *setToTrueFromAnyThreadToAbort) { cancellationFlag = setToTrueFromAnyThreadToAbort; }
+		void SetCancellationFlag(std::atomic<bool> *setToTrueFromAnyThreadToAbort) { cancellationFlag = setToTrueFromAnyThreadToAbort; }
+		/**
+		 * Streams a successful response body to the handler as it downloads, rather than parsing it as a whole into the
+		 * JSON of the result (which is then empty). Meant for large responses of which only some fields are needed.
+		 * @param handler handler called on the HTTP thread; owned by the request, so pass a new instance and do not delete it
+		 */
+		void SetStreamHandler(Helpers::CJsonStreamHandler *handler) { streamHandler <<= handler; streamReader <<= new Helpers::CJsonReader; }
+		/**
+		 * Same as SetStreamHandler, for bodies which are not a JSON document, such as a stream of server-sent events.
+		 * @param handler handler called on the HTTP thread; owned by the request, so pass a new instance and do not delete it
+		 */
+		void SetDataHandler(CHttpDataHandler *handler) { dataHandler <<= handler; }
+
+		// Headers that SetHeader accepts; the request's own ones, as the common ones are shared (see SetSharedHeaders)
+		enum { MaxHeaders = 4 };
 
 		void *getNextData(size_t size) { char *p = (char*)this->data + this->currentPos; this->currentPos += size; return p;}
 		size_t getNextSize(size_t maxSize) { return (maxSize >= this->dataLength-this->currentPos) ? this->dataLength-this->currentPos : maxSize; }
@@ -94,7 +155,10 @@ namespace XtraLife {
 		const char *method;
 		Helpers::cstring url;
 		Helpers::owned_ref<Helpers::CHJSON> json;
-		std::map<const char*, Helpers::cstring> headers;
+		// Set with SetHeader, formatted as sent ("Name: value") so that each attempt passes them to curl as is
+		Helpers::cstring headers[MaxHeaders];
+		int headerCount;
+		Helpers::autoref<CHttpHeaders> sharedHeaders;
 		CCallback *callback;
 		int connectTimeout, timeout;
 		RetryPolicy retryPolicy;
@@ -103,15 +167,73 @@ namespace XtraLife {
 		bool binaryUpload;
 		bool binaryDownload;
 		size_t currentPos;
-		bool *cancellationFlag;
+		std::atomic<bool> *cancellationFlag;
+		Helpers::owned_ref<Helpers::CJsonStreamHandler> streamHandler;
+		Helpers::owned_ref<Helpers::CJsonReader> streamReader;
+		Helpers::owned_ref<CHttpDataHandler> dataHandler;
 		
 		// Not allowed
 		CHttpRequest(const CHttpRequest &other);
 		CHttpRequest& operator = (const CHttpRequest &);
 		friend class RequestDispatcher;
+		friend class CHttpMultiplexer;
 		friend CCloudResult *http_perform_synchronous(CHttpRequest *request);
 	};
 
+	/**
+	 * Performs several requests at once on the calling thread. Each goes as with http_perform_synchronous, retries
+	 * included, but none blocks the others. Meant for long-lived requests such as the event long polls, which
+	 * then need neither a thread nor a connection wait of their own.
+	 * All methods but Wakeup must be called from the same thread.
+	 */
+	class CHttpMultiplexer {
+	public:
+		CHttpMultiplexer();
+		/** Aborts the requests still running. */
+		~CHttpMultiplexer();
+
+		/**
+		 * Starts a request.
+		 * @param request information about the request; the object will be owned by the multiplexer, so pass a 'new' reference and do not release it yourself
+		 * @param cookie identifies the request in Completed and Abort
+		 */
+		void Add(CHttpRequest *request, void *cookie);
+		/**
+		 * Aborts a request started with Add. It will not be returned by Completed.
+		 */
+		void Abort(void *cookie);
+		/**
+		 * Moves the transfers forward, waiting until one of them completes, Wakeup is called or timeoutMs has elapsed.
+		 */
+		void Perform(int timeoutMs);
+		/**
+		 * Call after Perform until it returns NULL to get the requests which have completed.
+		 * @param cookie set to the cookie of the request, as passed to Add
+		 * @return result of the request; must be deleted by you
+		 */
+		CCloudResult *Completed(void *&cookie);
+		/**
+		 * Makes a call to Perform return early (for instance to start a new request). May be called from any thread.
+		 */
+		void Wakeup();
+
+	private:
+		struct Transfer;
+		void Start(Transfer *transfer);
+		void Finish(Transfer *transfer);
+
+		void *mMulti;
+		std::vector<Transfer*> mTransfers, mCompleted;
+		bool mFailedLastTime;
+		// Used by Wakeup when curl can not interrupt its own wait
+		Helpers::CConditionVariable mWakeupVar;
+		bool mWakeupPending;
+
+		// Not allowed
+		CHttpMultiplexer(const CHttpMultiplexer &other);
+		CHttpMultiplexer& operator = (const CHttpMultiplexer &);
+	};
+
 	/**
 	 * Utility class that allows to build URLs more easily.
 	 */
@@ -1,4 +1,5 @@
 #include <time.h>
+#include <utility>
 
 #include "Core/CCallback.h"
 #include "Misc/helpers.h"
@@ -24,14 +25,27 @@ cstring::cstring(const cstring &other) : buffer(NULL) {
 	return res;
 }*/
 
-cstring::cstring(cstring &&other) {
-	buffer = other.buffer;
-	other.buffer = NULL;
+cstring::cstring(cstring &&other) : buffer(NULL) {
+	*this = std::move(other);
 }
 
 cstring& cstring::operator=(const char *other) {
-	if (buffer) { free(buffer); buffer = NULL; }
-	if (other) { buffer = strdup(other); }
+	if (!other) {
+		if (buffer != local) { free(buffer); }
+		buffer = NULL;
+		return *this;
+	}
+	// Reuse the storage we hold when the new string fits. memmove since other may point inside it.
+	size_t length = strlen(other);
+	if (buffer && length <= (buffer == local ? sizeof(local) - 1 : strlen(buffer))) {
+		memmove(buffer, other, length + 1);
+		return *this;
+	}
+	// Copy first, other may point inside our own buffer
+	char *copy = length < sizeof(local) ? local : (char*) malloc(length + 1);
+	memcpy(copy, other, length + 1);
+	if (buffer != local) { free(buffer); }
+	buffer = copy;
 	return *this;
 }
 
@@ -40,11 +54,22 @@ cstring& cstring::operator=(cstring &other) {
 }
 
 cstring& cstring::operator=(cstring &&other) {
-	*this = NULL; buffer = other.buffer; other.buffer = NULL; return *this;
+	if (this == &other) { return *this; }
+	if (other.buffer == other.local) {
+		// Short strings can't be stolen, but copying them costs no allocation either
+		*this = other.local;
+		other.buffer = NULL;
+	} else {
+		*this = NULL;
+		buffer = other.buffer;
+		other.buffer = NULL;
+	}
+	return *this;
 }
 
 cstring::~cstring() {
-	if (buffer) { free(buffer); buffer = NULL; }
+	if (buffer != local) { free(buffer); }
+	buffer = NULL;
 }
 
 cstring& cstring::operator<<=(char *other) {
@@ -57,31 +82,45 @@ bool cstring::IsEqual(const char *other) const {
 }
 
 char *cstring::DetachOwnership() {
-	char *result = buffer;
+	// Callers may free the result, so short strings have to leave their inline storage
+	char *result = buffer == local ? strdup(local) : buffer;
 	buffer = NULL;
 	return result;
 }
 
+// Formats into dest. Short results are formatted on the stack, so that the arguments may refer to dest itself, then
+// copied into dest, which reuses its storage when large enough; only longer ones need a second formatting pass.
+static cstring& vcsprintf(cstring &dest, const char *format, va_list args) {
+	char local[256];
+	va_list argsCopy;
+	va_copy(argsCopy, args);
+	size_t requiredChars = vsnprintf(local, sizeof(local), format, args);
+	if (requiredChars < sizeof(local)) {
+		dest = local;
+	} else {
+		char *buffer = (char*) malloc(requiredChars + 1);
+		vsnprintf(buffer, requiredChars + 1, format, argsCopy);
+		dest <<= buffer;
+	}
+	va_end(argsCopy);
+	return dest;
+}
+
 cstring& XtraLife::Helpers::csprintf(cstring &dest, const char *format, ...) {
 	va_list args;
 	va_start (args, format);
-	size_t requiredChars = vsnprintf(NULL, 0, format, args);
-	va_start (args, format);
-	char *buffer = new char[requiredChars + 1];
-	vsnprintf(buffer, requiredChars+1, format, args);
-	buffer[requiredChars] = 0;
-	return dest <<= buffer;
+	vcsprintf(dest, format, args);
+	va_end (args);
+	return dest;
 }
 
 cstring XtraLife::Helpers::csprintf(const char *format, ...) {
+	cstring result;
 	va_list args;
 	va_start (args, format);
-	size_t requiredChars = vsnprintf(NULL, 0, format, args);
-	va_start (args, format);
-	char *buffer = new char[requiredChars + 1];
-	vsnprintf(buffer, requiredChars+1, format, args);
-	buffer[requiredChars] = 0;
-	return cstring(buffer, true);
+	vcsprintf(result, format, args);
+	va_end (args);
+	return result;
 }
 
 char *XtraLife::print_current_time(char *dest, size_t dest_size, const char *format) {
@@ -114,7 +114,7 @@ void CAppStoreHandler::LaunchPurchase(const CHJSON *productInfo, CInternalResult
 				node.Put("internalProductId", product.productIdentifier.UTF8String);
 				node.Put("price", product.price.doubleValue);
 				node.Put("currency", formatter.currencyCode.UTF8String);
-				products->Add(node.Duplicate());
+				products->Add(std::move(node));
 			}
 			result->Put("products", products);
 
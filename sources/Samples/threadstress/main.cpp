@@ -0,0 +1,121 @@
+//
+//  main.cpp
+//  threadstress
+//
+//  Stress test for the objects the SDK shares between its threads: reference counted objects, results
+//  duplicated and released on other threads, and lazily parsed results read from several threads at once.
+//  It is meant to be run under ThreadSanitizer, which reports any data race it runs into, e.g. with:
+//
+//  g++ -std=c++11 -g -O1 -fsanitize=thread -I<sources>/include main.cpp <SDK sources or library> -lcurl -lpthread
+//
+
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <thread>
+#include <vector>
+
+#include "CDelegate.h"
+#include "CHJSON.h"
+
+using namespace XtraLife;
+using namespace XtraLife::Helpers;
+
+static const int kThreads = 8;
+static const char *kDocument = "{\"name\":\"tab\\tquote\\\"\\u00e9\",\"score\":1234,\"big\":9007199254740993,"
+    "\"ratio\":0.5,\"enabled\":true,\"items\":[1,2,3],\"profile\":{\"nick\":\"n\\\\1\"}}";
+
+static bool Check(bool condition, const char *what)
+{
+    if (!condition) { printf("FAILED: %s\n", what); }
+    return condition;
+}
+
+// Starts kThreads threads running body(thread index) and waits for them.
+template <class Body> static void RunThreads(Body body)
+{
+    std::vector<std::thread> threads;
+    for (int i = 0; i < kThreads; i++) { threads.emplace_back(body, i); }
+    for (std::thread &thread : threads) { thread.join(); }
+}
+
+struct Counted: CRefClass {
+    static std::atomic<int> destroyed;
+    int payload;
+    Counted() : payload(42) {}
+    ~Counted() { destroyed++; }
+};
+std::atomic<int> Counted::destroyed(0);
+
+// Each round, an object is shared by all threads, which retain and release it before dropping their reference.
+static bool RetainAndRelease()
+{
+    const int rounds = 200;
+    std::atomic<bool> ok(true);
+    for (int round = 0; round < rounds; round++) {
+        Counted *object = new Counted;
+        for (int i = 0; i < kThreads; i++) { object->Retain(); }
+        object->Release();
+        RunThreads([object, &ok](int) {
+            for (int k = 0; k < 1000; k++) {
+                object->Retain();
+                if (object->payload != 42) { ok = false; }
+                object->Release();
+            }
+            object->Release();
+        });
+    }
+    return Check(ok, "object modified while referenced") && Check(Counted::destroyed == rounds, "objects destroyed exactly once");
+}
+
+// Duplicates of a result share its binary data: each thread duplicates it, and the duplicates are released by the next thread.
+static bool DuplicateAcrossThreads(const CCloudResult *shared)
+{
+    const int copies = 200;
+    std::vector<CCloudResult*> made[kThreads];
+    std::atomic<bool> ok(true);
+    RunThreads([&](int i) {
+        for (int k = 0; k < copies; k++) {
+            CCloudResult *copy = shared->Duplicate();
+            if (copy->BinarySize() != shared->BinarySize() || copy->BinaryPtr() != shared->BinaryPtr()) { ok = false; }
+            if (copy->GetJSON()->GetInt("score") != 1234) { ok = false; }
+            made[i].push_back(copy);
+        }
+    });
+    RunThreads([&](int i) {
+        for (CCloudResult *copy : made[(i + 1) % kThreads]) { delete copy; }
+    });
+    return Check(ok, "duplicates match the original");
+}
+
+// Reads the same lazily parsed result from all threads at once, through the accessors of the JSON it holds.
+static bool ReadLazyResult(const CCloudResult *shared)
+{
+    std::atomic<bool> ok(true);
+    RunThreads([&](int) {
+        for (int k = 0; k < 2000; k++) {
+            const CHJSON *json = shared->GetJSON();
+            const char *name = json->GetString("name");
+            if (!name || strcmp(name, "tab\tquote\"\xc3\xa9")) { ok = false; }
+            if (json->GetInt("score") != 1234 || json->GetInt64("big") != 9007199254740993LL) { ok = false; }
+            if (json->GetDouble("ratio") != 0.5 || !json->GetBool("enabled") || !json->Has("items")) { ok = false; }
+            if (shared->GetErrorCode() != enNoErr || shared->GetHttpStatusCode() != 200) { ok = false; }
+        }
+    });
+    return Check(ok, "concurrent reads of a lazy result");
+}
+
+int main(int argc, const char * argv[]) {
+    CCloudResult *shared = new CCloudResult(enNoErr, CHJSON::parseLazy(strdup(kDocument)));
+    shared->SetHttpStatusCode(200);
+    shared->SetBinary(calloc(1, 64), 64);
+
+    bool ok = RetainAndRelease();
+    ok = ReadLazyResult(shared) && ok;
+    ok = DuplicateAcrossThreads(shared) && ok;
+    delete shared;
+
+    printf(ok ? "All passed\n" : "Some checks failed\n");
+    return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -71,6 +71,11 @@ namespace XtraLife
 			- "httpTimeout": sets a custom timeout for all requests. Defaults to no limit.
 			- "eventLoopTimeout": sets a custom timeout for the long polling event loop. Should be used with care and set to a
 			  high value (at least 60). Defaults to 590.
+			- "eventBatchSize": maximum number of queued events that the server may return in a single response of the event
+			  loop, on servers which support it. They are acknowledged together and passed to the listeners in a row. Defaults to 1.
+			- "eventTransport": how the event loop receives events. "longpoll" (the default) issues a request per event, while "sse"
+			  keeps a stream of server-sent events open, on servers which support it (others are then long polled anyway).
+			- "threadPoolSize": number of threads running the background tasks of the library. Defaults to the number of cores.
 			- "httpVerbose": set to true to output detailed information about the requests performed to XtraLife servers. Can be used
 			  for debugging, though it will pollute the logs very much.
 			@param handler result handler whenever the call finishes (it might also be synchronous)
@@ -52,9 +52,18 @@ namespace XtraLife {
 
 		/**
 		 * Reads the whole file from the current cursor position.
-		 * @return resulting string (or null in case of error), to be freed manually!
+		 * @param aSize if not NULL, receives the number of bytes read (the contents may hold NUL characters).
+		 * @return resulting string (or null in case of error), to be freed manually (with free())!
 		*/
-		char *ReadAll();
+		char *ReadAll(size_t *aSize = NULL);
+
+		/**
+		 * Gives direct access to the whole contents of the file, for implementations which can do it without reading it
+		 * (the default one maps the file in memory). The data stays valid until the file is closed.
+		 * @param aSize receives the size of the data.
+		 * @return the data, or NULL if not supported, in which case use Read().
+		*/
+		virtual const void *Map(size_t &) { return NULL; }
 
 		/**
 		 * Should give the absolute position of the cursor in the file.
@@ -165,12 +174,20 @@ namespace XtraLife {
 		void SetFilesystemHandler(CFilesystemHandler *aHandler, bool aDeleteAutomatically = true);
 
 		/**
-		 * Reads a JSON persisted to the storage.
+		 * Reads a JSON persisted to the storage, in text or binary form.
 		 * @param aRelativeName file name.
 		 * @return a JSON that you need to delete.
 		*/
 		Helpers::CHJSON *ReadJson(const char *aRelativeName);
-		bool WriteJson(const char *aRelativeName, const Helpers::CHJSON *aJSON);
+		/**
+		 * Persists a JSON to the storage.
+		 * @param aRelativeName file name.
+		 * @param aJSON the JSON to write.
+		 * @param aBinary whether to use a compact binary form (CBOR), which reads back much faster than text. Use it
+		 * for caches; files written that way can't be read by versions of the library which predate it.
+		 * @return whether the file could be written.
+		*/
+		bool WriteJson(const char *aRelativeName, const Helpers::CHJSON *aJSON, bool aBinary = false);
 
 	private:
 		CFilesystemHandler *mHandler;
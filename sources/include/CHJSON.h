@@ -12,11 +12,13 @@
 #include "XtraLife.h"
 #include <vector>
 #include <iterator>
+#include <utility>
 
 /*! \file CHJSON.h
  */
 
 struct cJSON;
+struct cJSON_Tape;
 
 namespace XtraLife {
     namespace Helpers {
@@ -42,6 +44,33 @@ namespace XtraLife {
              * @result is the JSON object, which you must delete.
              */
             static CHJSON *parse(const char *aJsonString);
+            /**
+             * Same as parse, but avoids copying the strings contained in the JSON: they are unescaped in place, inside the
+             * passed buffer, which becomes the backing store of the resulting JSON.
+             * @param aJsonBuffer NUL-terminated buffer allocated with malloc. Ownership is taken in any case (it will be freed
+             * along with the returned JSON, or immediately if parsing fails), and its contents are destroyed by the process.
+             * @result is the JSON object, which you must delete, or NULL if the string is not valid JSON.
+             */
+            static CHJSON *parseInSitu(char *aJsonBuffer);
+            /**
+             * Same as parseInSitu, but only indexes the structure of the document (unescaping strings in place, numbers
+             * being converted when read), so that reading a few fields of a large document doesn't cost building a tree
+             * of all of it. The tree is only built if the JSON is modified, except for adding keys at the top
+             * level, which are kept aside. Nodes returned by Get() are read-only views.
+             * @param aJsonBuffer NUL-terminated buffer allocated with malloc, taken ownership of as with parseInSitu.
+             * @result is the JSON object, which you must delete, or NULL if the string is not valid JSON.
+             */
+            static CHJSON *parseLazy(char *aJsonBuffer);
+            /**
+             * Move constructor: takes over the contents of another JSON without copying them, leaving it empty.
+             * @param aOther JSON to take the contents of (typically with std::move).
+             */
+            CHJSON(CHJSON &&aOther);
+            /**
+             * Move assignment: replaces the contents of this JSON by those of another, without copying them.
+             * @param aOther JSON to take the contents of, which is left empty.
+             */
+            CHJSON& operator = (CHJSON &&aOther);
             /**
              * Returns an empty JSON.
              */
@@ -83,6 +112,20 @@ namespace XtraLife {
              */
             const CHJSON *GetSafe(const char *aItem) const { const CHJSON *result = Get(aItem); return result ? result : Empty(); }
 
+            /** Method to retrieve a JSON anywhere inside this one, designated by a JSON Pointer (RFC 6901), such as
+                "/result/0" or "/event/move/change". Unlike chained Get() calls, only the node returned is allocated.
+                For paths used repeatedly, prefer a CJsonPath, which parses them once.
+                @param aPointer is the JSON Pointer. "" designates this JSON itself.
+                @result is the JSON retrieved. It's a NULL pointer if there is no such node. Do NOT delete it.
+             */
+            const CHJSON *At(const char *aPointer) const;
+
+            /** Preferred over At. Never returns NULL but an empty const node instead (see GetSafe).
+                @param aPointer is the JSON Pointer.
+                @result a JSON node, possibly empty.
+             */
+            const CHJSON *AtSafe(const char *aPointer) const { const CHJSON *result = At(aPointer); return result ? result : Empty(); }
+
             /** Helper method to retrieve a double value, given a key.
                 @param aItem is the key of the value you want to retrieve.
                 @param defaultValue the default value to return if the key is absent
@@ -96,6 +139,14 @@ namespace XtraLife {
                 @result is the value retrieved.
              */
             int GetInt(const char *aItem, int defaultValue = 0) const;
+
+            /** Helper method to retrieve a 64-bit integer value (such as a score or a balance), given a key.
+                Unlike GetDouble, integers up to 64 bits received from the server are returned without loss of precision.
+                @param aItem is the key of the value you want to retrieve.
+                @param defaultValue the default value to return if the key is absent
+                @result is the value retrieved.
+             */
+            long long GetInt64(const char *aItem, long long defaultValue = 0) const;
             
             /** Helper method to retrieve a boolean value, given a key.
                 @param aItem is the key of the value you want to retrieve.
@@ -125,6 +176,36 @@ namespace XtraLife {
              */
             CHJSON *Duplicate() const;
 
+            /** Formats of the patches produced by Diff. */
+            typedef enum {
+                /// RFC 7396 merge patch: an object holding what changed, with null for the keys removed. Arrays are
+                /// replaced as a whole, and keys can't be set to null (patches read it as a removal).
+                patchMerge,
+                /// RFC 6902 JSON Patch: an array of add/remove/replace operations, each addressing a value by JSON Pointer.
+                patchJson
+            } patchFormat;
+
+            /**
+             * Computes the changes turning a JSON into another one, for instance to only send what was modified in a
+             * locally cached document.
+             * @param aFrom is the original JSON.
+             * @param aTo is the modified JSON.
+             * @param aFormat is the kind of patch to produce.
+             * @result is the patch, such that aFrom->ApplyPatch(patch) gives aTo. It must be deleted by you. A merge patch is
+             * {} and a JSON Patch is [] when both are equal.
+             */
+            static CHJSON *Diff(const CHJSON *aFrom, const CHJSON *aTo, patchFormat aFormat = patchMerge);
+
+            /**
+             * Modifies this JSON according to a patch, such as one produced by Diff. A JSON Patch is applied entirely or
+             * not at all.
+             * @param aPatch is the patch to apply (not retained).
+             * @param aFormat is the kind of patch.
+             * @result is false if the patch could not be applied (malformed operation, path not found or failed "test"),
+             * in which case this JSON is left unchanged.
+             */
+            bool ApplyPatch(const CHJSON *aPatch, patchFormat aFormat = patchMerge);
+
             /**
                 Used to add, or replace if the key already exists, a boolean value.
                 @param aKey is the key to add or replace.
@@ -138,6 +219,13 @@ namespace XtraLife {
                 @param aValue is the int value used.
              */
             void Put(const char *aKey, int aValue);
+
+            /**
+                Used to add, or replace if the key already exists, a 64-bit integer value. It is serialized exactly.
+                @param aKey is the key to add or replace.
+                @param aValue is the integer value used.
+             */
+            void Put(const char *aKey, long long aValue);
             
             /**
                 Used to add, or replace if the key already exists, a double value.
@@ -173,6 +261,12 @@ namespace XtraLife {
              * @param json is the value to put inside (copy)
              */
             void Put(const char *aKey, const CHJSON& json) { Put(aKey, json.Duplicate()); }
+            /**
+             * Adds or replaces a JSON built locally, moving its nodes without copying them, as in json.Put("score", std::move(score)).
+             * @param aKey is the key to add or replace.
+             * @param json is the value to put inside, which is left empty (nodes obtained from it with Get() become invalid)
+             */
+            void Put(const char *aKey, CHJSON &&json);
 
             struct Iterator: std::iterator<std::forward_iterator_tag, const CHJSON*> {
                 Iterator(const CHJSON *json, int index);
@@ -210,6 +304,20 @@ namespace XtraLife {
             cstring printFormatted() const;
             cstring& printFormatted(cstring& dest) const;
 
+            /** Method which serializes the JSON object in a compact binary form (CBOR), suitable for storage. It is read
+                back with parseBinary, much faster than text.
+                @param aSize receives the size of the result.
+                @result is a buffer which must be released using free(), or NULL in case of failure.
+             */
+            void *printBinary(size_t &aSize) const;
+
+            /** Static function which builds a JSON object from the binary form produced by printBinary.
+                @param aData the binary data (not retained).
+                @param aSize the size of the data.
+                @result is the JSON object, which you must delete, or NULL if the data is not a JSON in binary form.
+             */
+            static CHJSON *parseBinary(const void *aData, size_t aSize);
+
             //////////////////////////// Creating arrays ////////////////////////////
 
             /** Static function to create a JSON as an empty array. Will create a JSON of type jsonArray.
@@ -250,6 +358,17 @@ namespace XtraLife {
              */
             void Add(CHJSON *aJson);
 
+            /** Same, moving the nodes of a JSON built locally into the array without copying them.
+                @param aJson is the JSON to be added to the array, which is left empty.
+             */
+            void Add(CHJSON &&aJson);
+
+            /** Method to move all the elements of another array at the end of this one at once, without copying them, such as
+                to join parts of a large batch built separately. Adding elements one by one with Add takes constant time too.
+                @param aJson is the array whose elements are moved. The item will be automatically destroyed after this call.
+             */
+            void Concat(CHJSON *aJson);
+
             /** Methods which gives the number of elements inside the JSON.
                 @result is the number of elements. If not jsonArray or jsonObject, will always be 0.
              */
@@ -310,6 +429,11 @@ namespace XtraLife {
                 @result is the value, will be 0 if type is not jsonNumber.
              */
             int valueInt() const;
+
+            /** Method which returns a 64-bit integer if the JSON object is of type jsonNumber.
+                @result is the value, will be 0 if type is not jsonNumber.
+             */
+            long long valueInt64() const;
             
             /** Method which returns a double if the JSON object is of type jsonNumber.
              @result is the value, will be 0 if type is not jsonNumber.
@@ -381,15 +505,121 @@ namespace XtraLife {
             static CHJSON *dup(const CHJSON *aJson);
 
         private:
+            friend class CJsonPath;
+            friend struct CJsonStruct;
             void push(CHJSON *json) const ;
             void garbage() const;
+            void adopt(CHJSON *json);
+            void releaseBackingStore();
+            const cJSON *node(cJSON &scratch) const;
+            const cJSON *lookup(const char *key, cJSON &scratch) const;
+            const CHJSON *view(int tapeIndex) const;
+            const CHJSON *wrap(cJSON *node, int tapeIndex) const;
+            bool resolve(const class CJsonPath &path, cJSON *&node, int &tapeIndex) const;
+            static cJSON *locate(cJSON *root, const CJsonPath &path, int steps);
+            static cJSON *detach(cJSON *root, const CJsonPath &path);
+            static bool insert(cJSON *root, const CJsonPath &path, cJSON *value);
+            static bool applyOperation(cJSON *root, cJSON *operation);
+            void makeWritable(const char *key = 0);
+            cJSON *borrowTree(cJSON *&last) const;
+            void returnTree(cJSON *json, cJSON *last) const;
+            cstring& printInto(cstring &dest, int fmt) const;
             mutable CHJSON *mNext;
+            // Buffers which in-situ parsed nodes of this tree point to
+            struct CBackingStore *mBacking;
             
             // Use Duplicate instead and manipulate pointers
             CHJSON(const CHJSON &forbiddenCopyCtor);
             CHJSON(cJSON *json, bool tobereleased = false);
             cJSON *mJSON;
             bool release;
+            // Lazily parsed node: its index in the tape (owned by the backing store of the root), or -1. A lazy root
+            // keeps the keys added to it in mJSON.
+            cJSON_Tape *mTape;
+            int mTapeIndex;
+        };
+
+        /**
+         * JSON Pointer (RFC 6901) parsed once, to be resolved against many documents. Resolving walks the document
+         * directly, without allocating intermediate nodes, and reading a value through the typed getters allocates nothing.
+         * Suited to event handlers, which look up the same fields of every event.
+         * @code
+         * static const CJsonPath change("/event/move/change");
+         * int value = change.GetInt(event->GetJSON());
+         * @endcode
+         * A path may be shared between threads once constructed.
+         */
+        class FACTORY_CLS CJsonPath
+        {
+        public:
+            /**
+             * @param aPointer is the JSON Pointer, such as "/result/0". "" designates the document itself.
+             */
+            CJsonPath(const char *aPointer);
+            ~CJsonPath();
+
+            /**
+             * @return whether the pointer given at construction is well formed. A malformed one never designates anything.
+             */
+            bool IsValid() const { return mValid; }
+
+            /** Same as json->At(pointer).
+                @param aJson is the document to look into.
+                @result is the JSON retrieved, owned by aJson. It's a NULL pointer if there is no such node.
+             */
+            const CHJSON *Get(const CHJSON *aJson) const;
+
+            /** Same as json->AtSafe(pointer): never returns NULL but an empty const node instead.
+                @param aJson is the document to look into.
+                @result a JSON node, possibly empty.
+             */
+            const CHJSON *GetSafe(const CHJSON *aJson) const { const CHJSON *result = Get(aJson); return result ? result : CHJSON::Empty(); }
+
+            /**
+             * @param aJson is the document to look into.
+             * @return whether the document holds a value at this path (regardless of its type)
+             */
+            bool Has(const CHJSON *aJson) const;
+
+            /**
+             * @return the string at this path, or defaultValue if there is none / it is not a string
+             */
+            const char *GetString(const CHJSON *aJson, const char *defaultValue = 0) const;
+            /**
+             * @return the number at this path, or defaultValue if there is none / it is not a number
+             */
+            int GetInt(const CHJSON *aJson, int defaultValue = 0) const;
+            /**
+             * @return the number at this path (exact for 64-bit integers), or defaultValue if there is none / it is not a number
+             */
+            long long GetInt64(const CHJSON *aJson, long long defaultValue = 0) const;
+            /**
+             * @return the number at this path, or defaultValue if there is none / it is not a number
+             */
+            double GetDouble(const CHJSON *aJson, double defaultValue = 0) const;
+            /**
+             * @return whether the value at this path is true, or defaultValue if there is none
+             */
+            bool GetBool(const CHJSON *aJson, bool defaultValue = false) const;
+
+        private:
+            friend class CHJSON;
+            const cJSON *value(const CHJSON *json, cJSON &scratch) const;
+
+            // One per reference token: the unescaped key, and the array index it designates, or -1 if it is not one
+            struct Step {
+                const char *key;
+                int index;
+            };
+            Step *mSteps;
+            int mCount;
+            // Keys of the steps, one after another
+            char *mKeys;
+            bool mValid;
+
+            // Not allowed
+            CJsonPath(const CJsonPath &other);
+            CJsonPath& operator = (const CJsonPath &other);
         };
 
     }
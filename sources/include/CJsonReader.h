@@ -0,0 +1,153 @@
+#ifndef XtraLife_CJsonReader_h
+#define XtraLife_CJsonReader_h
+
+#include <stddef.h>
+#include "XtraLife.h"
+
+/*! \file CJsonReader.h
+ */
+
+namespace XtraLife {
+    namespace Helpers {
+
+        /**
+         * Pull parser for JSON documents which arrive piece by piece, such as an HTTP response being downloaded.
+         *
+         * Feed() it with data as it comes, then call Next() until it returns tokNeedMore. Unlike CHJSON, no tree is
+         * built: memory use is bounded by the nesting depth and the largest single token rather than the size of the
+         * document, and reading may stop as soon as the interesting part has been seen.
+         * @code
+         * reader.Feed(data, length);
+         * for (CJsonReader::Token t = reader.Next(); t != CJsonReader::tokNeedMore; t = reader.Next()) {
+         *     if (t == CJsonReader::tokKey && !strcmp(reader.String(), "profile")) { reader.SkipValue(); }
+         *     ...
+         * }
+         * @endcode
+         */
+        class FACTORY_CLS CJsonReader {
+        public:
+            enum Token {
+                /// Everything fed so far has been consumed. Feed() more data, or call Finish() if there is none.
+                tokNeedMore,
+                /// Start of an object; Depth() now includes it.
+                tokStartObject,
+                tokEndObject,
+                /// Start of an array; Depth() now includes it.
+                tokStartArray,
+                tokEndArray,
+                /// An object key, available through String().
+                tokKey,
+                /// A string value, available through String().
+                tokString,
+                /// A number, available through Double() or Int64() (String() holds its text).
+                tokNumber,
+                tokTrue,
+                tokFalse,
+                tokNull,
+                /// The document is complete. Any data past it is ignored.
+                tokEnd,
+                /// The document is malformed (see ErrorOffset()). Every further call returns tokError.
+                tokError
+            };
+
+            /**
+             * @param maxDepth maximum nesting of objects/arrays before failing, 0 for the same limit as CHJSON::parse.
+             */
+            CJsonReader(int maxDepth = 0);
+            ~CJsonReader();
+
+            /**
+             * Appends a piece of the document. Only the data not yet consumed by Next() is kept, so you may free yours.
+             */
+            void Feed(const char *data, size_t length);
+            /**
+             * Indicates that no more data will be fed, so that a trailing number can be read, and truncated documents fail.
+             */
+            void Finish();
+            /**
+             * Forgets everything in order to read a new document.
+             */
+            void Reset();
+
+            /**
+             * Reads the next token.
+             * @return the token, or tokNeedMore when the data fed so far doesn't hold another complete token
+             */
+            Token Next();
+            /**
+             * Call right after reading a tokKey to have Next() skip its value, or after a tokStartObject/tokStartArray to skip
+             * the rest of that container, including its closing token. Skipped data is not decoded.
+             */
+            void SkipValue();
+
+            /**
+             * @return the key, string value or number text of the last token (NUL-terminated, valid until the next call to Next())
+             */
+            const char *String() const { return mValue ? mValue : ""; }
+            /**
+             * @return length of String(), which may hold NUL characters if they were escaped in the document
+             */
+            size_t StringLength() const { return mValueLength; }
+            /** @return the value of the last tokNumber */
+            double Double() const { return mDouble; }
+            /** @return the value of the last tokNumber, exact for integers up to 64 bits */
+            long long Int64() const { return mInt64; }
+            /** @return number of objects/arrays containing the current position */
+            int Depth() const { return mDepth; }
+            /** @return offset in the whole document (as fed) at which the error was detected, after Next() returned tokError */
+            size_t ErrorOffset() const { return mErrorOffset; }
+
+        private:
+            Token Lex();
+            Token LexValue(char c);
+            Token LexString(Token token);
+            Token LexNumber();
+            Token LexLiteral(const char *literal, Token token);
+            Token CloseContainer(char c);
+            Token Scalar(Token token);
+            Token Fail();
+            bool Unescape(const char *from, const char *to);
+            bool ReserveValue(size_t size);
+
+            // Unconsumed input is mBuffer[mStart..mEnd)
+            char *mBuffer;
+            size_t mStart, mEnd, mCapacity, mDiscarded, mScanResume;
+            // Decoded value of the last token
+            char *mValue;
+            size_t mValueLength, mValueCapacity;
+            double mDouble;
+            long long mInt64;
+            // Opening character of each open container
+            char *mStack;
+            int mDepth, mMaxDepth, mStackCapacity;
+            int mState, mSkipDepth;
+            Token mLast;
+            bool mFinished, mSkipping;
+            size_t mErrorOffset;
+
+            // Not allowed
+            CJsonReader(const CJsonReader &other);
+            CJsonReader& operator = (const CJsonReader &other);
+        };
+
+        /**
+         * Receives the body of an HTTP response while it downloads, instead of a complete CHJSON (see CHttpRequest::SetStreamHandler).
+         * Only successful (2xx) responses are streamed; error responses are delivered through the result as usual.
+         */
+        struct FACTORY_CLS CJsonStreamHandler {
+            virtual ~CJsonStreamHandler() {}
+            /**
+             * Called on the HTTP thread before the body starts, including again if the request is retried after a failure.
+             */
+            virtual void OnBegin(CJsonReader &) {}
+            /**
+             * Called on the HTTP thread after each piece of the body has been fed to the reader, and once more after
+             * reader.Finish() at the end of the response. Pull tokens until Next() returns tokNeedMore.
+             * @return false to stop the download; the rest of the response is discarded and the request completes normally
+             */
+            virtual bool OnData(CJsonReader &reader) = 0;
+        };
+    }
+}
+
+#endif
@@ -0,0 +1,205 @@
+#ifndef XtraLife_CJsonStruct_h
+#define XtraLife_CJsonStruct_h
+
+#include <vector>
+#include "XtraLife.h"
+#include "XtraLifeHelpers.h"
+#include "CHJSON.h"
+
+/*! \file CJsonStruct.h
+ */
+
+/**
+ * Declares the fields of a struct which CJsonStruct::Decode fills from a JSON object. Put it inside the struct, after the
+ * members, listing them with XTRALIFE_JSON_FIELD (member named as the key) or XTRALIFE_JSON_FIELD_NAMED.
+ * @code
+ * struct CMyResult {
+ *     cstring name;
+ *     int level = 0;
+ *     std::vector<cstring> items;
+ *     XTRALIFE_JSON_FIELDS(CMyResult, XTRALIFE_JSON_FIELD(name), XTRALIFE_JSON_FIELD_NAMED(level, "lvl"), XTRALIFE_JSON_FIELD(items))
+ * };
+ * @endcode
+ * Members may be cstring, int, long long, double, bool, owned_ref<CHJSON> (a copy of the value, whatever its type),
+ * another struct declaring its fields, or a std::vector of any of these (but owned_ref).
+ */
+#define XTRALIFE_JSON_FIELDS(type, ...) \
+    typedef type JsonSelf; \
+    static const XtraLife::Helpers::CJsonSchema &JsonSchema() { \
+        static const XtraLife::Helpers::CJsonField fields[] = { __VA_ARGS__ }; \
+        static const XtraLife::Helpers::CJsonSchema schema = { fields, (int) (sizeof(fields) / sizeof(*fields)) }; \
+        return schema; \
+    }
+#define XTRALIFE_JSON_FIELD_NAMED(member, key) \
+    XtraLife::Helpers::JsonField(key, &XtraLife::Helpers::JsonMember<JsonSelf, decltype(JsonSelf::member), &JsonSelf::member>, \
+        (decltype(JsonSelf::member) *) 0)
+#define XTRALIFE_JSON_FIELD(member) XTRALIFE_JSON_FIELD_NAMED(member, #member)
+
+namespace XtraLife {
+    namespace Helpers {
+
+        struct CJsonSchema;
+        struct CJsonStructNode;
+
+        /**
+         * Description of a field of a struct, built by XTRALIFE_JSON_FIELD.
+         */
+        struct CJsonField {
+            enum Kind { fieldString, fieldInt, fieldInt64, fieldDouble, fieldBool, fieldJson, fieldObject, fieldArray };
+            /// Key in the JSON object
+            const char *name;
+            Kind kind;
+            /// Address of the member in a given struct
+            void *(*member)(void *object);
+            /// fieldObject: description of the struct
+            const CJsonSchema &(*schema)();
+            /// fieldArray: description of an element, and handling of the std::vector
+            const CJsonField &(*element)();
+            void *(*append)(void *array);
+            void (*clear)(void *array);
+        };
+
+        /**
+         * Fields of a struct, as declared by XTRALIFE_JSON_FIELDS.
+         */
+        struct CJsonSchema {
+            const CJsonField *fields;
+            int count;
+        };
+
+        /**
+         * Fills plain C++ structs from JSON results, in a single pass over each object rather than one key lookup per
+         * field, and without allocating intermediate CHJSON nodes.
+         * @code
+         * CLoginResult login;
+         * if (CJsonStruct::Decode(result->GetJSON(), login)) { Log(login.gamer_id); }
+         * @endcode
+         */
+        struct FACTORY_CLS CJsonStruct {
+            /**
+             * Sets the members of dest found in json. Members whose key is absent, or whose value has another type, keep
+             * their value; arrays are replaced.
+             * @param aJson the JSON object to decode (typically CCloudResult::GetJSON()).
+             * @param aDest the struct to fill, declared with XTRALIFE_JSON_FIELDS.
+             * @return false if aJson is NULL or not an object
+             */
+            template <class T>
+            static bool Decode(const CHJSON *aJson, T &aDest) { return Decode(aJson, T::JsonSchema(), &aDest); }
+            static bool Decode(const CHJSON *aJson, const CJsonSchema &aSchema, void *aDest);
+
+        private:
+            static void decodeObject(const CJsonStructNode &object, const CJsonSchema &schema, void *dest);
+            static void decodeValue(const CJsonStructNode &node, const CJsonField &field, void *dest);
+        };
+
+        // Used by XTRALIFE_JSON_FIELD: what describes a member, depending on its type
+        template <class S, class M, M S::*member>
+        void *JsonMember(void *object) { return &(static_cast<S*>(object)->*member); }
+
+        template <class T> struct CJsonElement;
+
+        inline CJsonField JsonField(const char *name, void *(*member)(void*), cstring *) { CJsonField f = { name, CJsonField::fieldString, member, NULL, NULL, NULL, NULL }; return f; }
+        inline CJsonField JsonField(const char *name, void *(*member)(void*), int *) { CJsonField f = { name, CJsonField::fieldInt, member, NULL, NULL, NULL, NULL }; return f; }
+        inline CJsonField JsonField(const char *name, void *(*member)(void*), long long *) { CJsonField f = { name, CJsonField::fieldInt64, member, NULL, NULL, NULL, NULL }; return f; }
+        inline CJsonField JsonField(const char *name, void *(*member)(void*), double *) { CJsonField f = { name, CJsonField::fieldDouble, member, NULL, NULL, NULL, NULL }; return f; }
+        inline CJsonField JsonField(const char *name, void *(*member)(void*), bool *) { CJsonField f = { name, CJsonField::fieldBool, member, NULL, NULL, NULL, NULL }; return f; }
+        inline CJsonField JsonField(const char *name, void *(*member)(void*), owned_ref<CHJSON> *) { CJsonField f = { name, CJsonField::fieldJson, member, NULL, NULL, NULL, NULL }; return f; }
+        template <class T>
+        CJsonField JsonField(const char *name, void *(*member)(void*), T *) { CJsonField f = { name, CJsonField::fieldObject, member, &T::JsonSchema, NULL, NULL, NULL }; return f; }
+        template <class T>
+        CJsonField JsonField(const char *name, void *(*member)(void*), std::vector<T> *) {
+            CJsonField f = { name, CJsonField::fieldArray, member, NULL, &CJsonElement<T>::Field, &CJsonElement<T>::Append, &CJsonElement<T>::Clear };
+            return f;
+        }
+
+        template <class T>
+        struct CJsonElement {
+            static const CJsonField &Field() { static const CJsonField field = JsonField(NULL, NULL, (T *) 0); return field; }
+            static void *Append(void *array) { std::vector<T> &v = *static_cast<std::vector<T>*>(array); v.push_back(T()); return &v.back(); }
+            static void Clear(void *array) { static_cast<std::vector<T>*>(array)->clear(); }
+        };
+    }
+
+    /** @defgroup json_structs Predefined result structs
+     * Structs to decode common results with CJsonStruct::Decode.
+     * @{
+     */
+
+    /**
+     * Profile of a gamer, as found in login results, scores or matches, and returned by CUserManager::GetProfile.
+     */
+    struct CGamerProfile {
+        Helpers::cstring displayName, lang, email, firstName, lastName, avatar;
+        XTRALIFE_JSON_FIELDS(CGamerProfile, XTRALIFE_JSON_FIELD(displayName), XTRALIFE_JSON_FIELD(lang), XTRALIFE_JSON_FIELD(email),
+            XTRALIFE_JSON_FIELD(firstName), XTRALIFE_JSON_FIELD(lastName), XTRALIFE_JSON_FIELD(avatar))
+    };
+
+    /**
+     * A gamer referred to in a result, such as a player of a match.
+     */
+    struct CGamerInfo {
+        Helpers::cstring gamer_id;
+        CGamerProfile profile;
+        XTRALIFE_JSON_FIELDS(CGamerInfo, XTRALIFE_JSON_FIELD(gamer_id), XTRALIFE_JSON_FIELD(profile))
+    };
+
+    /**
+     * Result of the login calls of CUserManager (LoginAnonymous, LoginNetwork, ResumeSession...).
+     */
+    struct CLoginResult {
+        Helpers::cstring gamer_id, gamer_secret, network, networkid;
+        CGamerProfile profile;
+        XTRALIFE_JSON_FIELDS(CLoginResult, XTRALIFE_JSON_FIELD(gamer_id), XTRALIFE_JSON_FIELD(gamer_secret), XTRALIFE_JSON_FIELD(network),
+            XTRALIFE_JSON_FIELD(networkid), XTRALIFE_JSON_FIELD(profile))
+    };
+
+    /**
+     * A score, as posted with CGameManager::Score.
+     */
+    struct CScoreValue {
+        long long score = 0;
+        Helpers::cstring info, timestamp;
+        XTRALIFE_JSON_FIELDS(CScoreValue, XTRALIFE_JSON_FIELD(score), XTRALIFE_JSON_FIELD(info), XTRALIFE_JSON_FIELD(timestamp))
+    };
+
+    /**
+     * An entry of a page of scores.
+     */
+    struct CScoreEntry {
+        Helpers::cstring gamer_id;
+        CGamerProfile profile;
+        CScoreValue score;
+        XTRALIFE_JSON_FIELDS(CScoreEntry, XTRALIFE_JSON_FIELD(gamer_id), XTRALIFE_JSON_FIELD(profile), XTRALIFE_JSON_FIELD(score))
+    };
+
+    /**
+     * Page of scores of a board, as returned by CGameManager::BestHighScore or CenteredScore under the key of the mode:
+     * decode result->GetJSON()->Get(mode).
+     */
+    struct CScorePage {
+        int maxpage = 0, page = 0, rankOfFirst = 0;
+        std::vector<CScoreEntry> scores;
+        XTRALIFE_JSON_FIELDS(CScorePage, XTRALIFE_JSON_FIELD(maxpage), XTRALIFE_JSON_FIELD(page), XTRALIFE_JSON_FIELD(rankOfFirst),
+            XTRALIFE_JSON_FIELD(scores))
+    };
+
+    /**
+     * A match, as found under the "match" key of the results of CMatchManager (decode result->GetJSON()->Get("match")).
+     * Freeform parts are kept as JSON.
+     */
+    struct CMatchInfo {
+        Helpers::cstring _id, match_id, domain, status, description, lastEventId;
+        int maxPlayers = 0, seed = 0;
+        CGamerInfo creator;
+        std::vector<CGamerInfo> players;
+        Helpers::owned_ref<Helpers::CHJSON> customProperties, globalState, shoe;
+        XTRALIFE_JSON_FIELDS(CMatchInfo, XTRALIFE_JSON_FIELD(_id), XTRALIFE_JSON_FIELD(match_id), XTRALIFE_JSON_FIELD(domain),
+            XTRALIFE_JSON_FIELD(status), XTRALIFE_JSON_FIELD(description), XTRALIFE_JSON_FIELD(lastEventId),
+            XTRALIFE_JSON_FIELD(maxPlayers), XTRALIFE_JSON_FIELD(seed), XTRALIFE_JSON_FIELD(creator), XTRALIFE_JSON_FIELD(players),
+            XTRALIFE_JSON_FIELD(customProperties), XTRALIFE_JSON_FIELD(globalState), XTRALIFE_JSON_FIELD(shoe))
+    };
+
+    /** @} */
+}
+
+#endif
@@ -63,6 +63,9 @@ namespace XtraLife {
 			const char *type = event->GetJSON()->GetString("type", "");
 			if (!strcmp(type, "match.move")) {
 				int change = event->GetJSON()->GetSafe("event")->GetSafe("move")->GetInt("change");
+				// Or, without allocating intermediate nodes (see CJsonPath):
+				static const CJsonPath changePath("/event/move/change");
+				change = changePath.GetInt(event->GetJSON());
 			}
 		 @endcode
 		 The following types of events may be received:
@@ -4,6 +4,7 @@
 #include "XtraLife.h"
 
 #include <string.h>
+#include <atomic>
 
 /*! \file XtraLifeHelpers.h
  */
@@ -90,23 +91,40 @@ namespace XtraLife {
             b.useMember();			// exception \endcode
             *
             * In this example, the object A is destroyed by the compiler as we reach the end of the block, but it is still retained in B. This is why it is highly recommended not to create CRefClass'es on the stack except for local use.
+            *
+            * Retain() and Release() may be called from any thread. Objects which never leave a thread may be built with
+            * singleThreaded, which makes them slightly cheaper by counting references without atomic operations.
          */
         struct FACTORY_CLS CRefClass {
-            unsigned __ref_count;		// -1 => freed (an unmanaged object will be left at 0)
-            CRefClass() : __ref_count(0) {}
+            enum threading { multiThreaded, singleThreaded };
+
+            std::atomic<unsigned> __ref_count;		// -1 => freed (an unmanaged object will be left at 0)
+            const bool __single_threaded;
+            CRefClass(threading aThreading = multiThreaded) : __ref_count(0), __single_threaded(aThreading == singleThreaded) {}
             virtual ~CRefClass() noexcept(false);
 
-            // Simple reference inc/decrementers
-            void Retain() { __ref_count++; }
-            void Release() { if (__ref_count-- == 0) delete this; }
+            // Reference inc/decrementers; the last Release synchronizes with the others before deleting the object
+            void Retain() {
+                if (__single_threaded) { __ref_count.store(__ref_count.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed); }
+                else { __ref_count.fetch_add(1, std::memory_order_relaxed); }
+            }
+            void Release() {
+                if (__single_threaded) {
+                    unsigned count = __ref_count.load(std::memory_order_relaxed);
+                    __ref_count.store(count - 1, std::memory_order_relaxed);
+                    if (count == 0) { delete this; }
+                } else if (__ref_count.fetch_sub(1, std::memory_order_acq_rel) == 0) {
+                    delete this;
+                }
+            }
 
             // Null-safe version of Retain/Release with a return of the right subtype
             template <class T> static T* Retain(T *t) { if (t) t->Retain(); return t; }
             template <class T> static T* Release(T *t) { if (t) t->Release(); return NULL; }
 
             // Always call the base member when overriding these!
-            CRefClass(const CRefClass& other) : __ref_count(other.__ref_count) {}
-            CRefClass& operator = (const CRefClass& other) { __ref_count = other.__ref_count; return *this; }
+            CRefClass(const CRefClass& other) : __ref_count(other.__ref_count.load()), __single_threaded(other.__single_threaded) {}
+            CRefClass& operator = (const CRefClass& other) { __ref_count = other.__ref_count.load(); return *this; }
         };
 
         /** @}
@@ -118,6 +136,8 @@ namespace XtraLife {
          * - Automatically initializes to NULL
          * - Duplicates the assigned string
          * - Frees the assigned string upon destruction or assignment of a different one
+         * - Holds strings of up to 22 characters inline, without allocating: c_str() then points inside the object itself,
+         *   and is invalidated when it is moved
          * Miniature version of std::string. Equivalents (char* / cstring):
          * {                                   {
          *     char *str = NULL;
@@ -159,7 +179,9 @@ namespace XtraLife {
             char *DetachOwnership();
 
         private:
+            // Points to local for strings short enough to be held inline, sparing an allocation
             char *buffer;
+            char local[23];
         };
 
         /**